@@ -1,10 +1,18 @@
 #ifndef SIKZAD1_AUXILIARY_H
 #define SIKZAD1_AUXILIARY_H
 
+#include <algorithm>
 #include <exception>
+#include <filesystem>
 
 namespace SIK {
     class ServerException : public std::exception {};
+
+    /* Returns true if the path lies within the root directory. Both paths must be canonical. */
+    inline bool isWithin(const std::filesystem::path &rootDirectory, const std::filesystem::path &filePath) {
+        return std::mismatch(rootDirectory.begin(), rootDirectory.end(), filePath.begin(), filePath.end()).first ==
+               rootDirectory.end();
+    }
 }
 
 #endif //SIKZAD1_AUXILIARY_H
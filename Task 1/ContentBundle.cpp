@@ -0,0 +1,297 @@
+#include "ContentBundle.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+    namespace fs = std::filesystem;
+
+    /* Writes count bytes from the buffer to the descriptor. */
+    void writeAll(int descriptor, const void *buffer, size_t count) {
+        auto ptr = static_cast<const char *>(buffer);
+
+        while (count > 0) {
+            ssize_t bytesWritten = write(descriptor, ptr, count);
+
+            if (bytesWritten < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                throw SIK::BundleWriteException{};
+            }
+
+            ptr += bytesWritten;
+            count -= bytesWritten;
+        }
+    }
+
+    /* Appends contents of the file to the bundle. Returns size and hash of the contents. */
+    std::pair<uint64_t, uint64_t> appendFile(int bundleDescriptor, const fs::path &filePath) {
+        int fileDescriptor = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (fileDescriptor < 0) {
+            throw SIK::BundleWriteException{};
+        }
+
+        static char buffer[65536];
+
+        uint64_t fileSize = 0;
+        uint64_t contentHash = SIK::ContentBundle::hash({});
+
+        while (true) {
+            ssize_t bytesRead = read(fileDescriptor, buffer, sizeof(buffer));
+
+            if (bytesRead < 0 && errno == EINTR) {
+                continue;
+            }
+
+            if (bytesRead < 0) {
+                close(fileDescriptor);
+                throw SIK::BundleWriteException{};
+            }
+
+            if (bytesRead == 0) {
+                break;
+            }
+
+            writeAll(bundleDescriptor, buffer, bytesRead);
+
+            contentHash = SIK::ContentBundle::hash({buffer, static_cast<size_t>(bytesRead)}, contentHash);
+            fileSize += bytesRead;
+        }
+
+        close(fileDescriptor);
+
+        return {fileSize, contentHash};
+    }
+}
+
+namespace SIK {
+    ContentBundle::ContentBundle(const fs::path &bundlePath) {
+        descriptor = open(bundlePath.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (descriptor < 0) {
+            throw BundleOpenException{};
+        }
+
+        struct stat bundleStat{};
+
+        if (fstat(descriptor, &bundleStat) < 0) {
+            close(descriptor);
+            throw BundleOpenException{};
+        }
+
+        size = bundleStat.st_size;
+
+        if (size < sizeof(Header)) {
+            close(descriptor);
+            throw BundleFormatException{};
+        }
+
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0);
+
+        if (mapping == MAP_FAILED) {
+            close(descriptor);
+            throw BundleOpenException{};
+        }
+
+        data = static_cast<const char *>(mapping);
+
+        try {
+            validate();
+        } catch (...) {
+            munmap(mapping, size);
+            close(descriptor);
+            throw;
+        }
+
+        /* Index is touched by every request, while bodies go straight from the page cache to the socket. */
+        auto pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+        auto indexPageOffset = header().indexOffset / pageSize * pageSize;
+        madvise(const_cast<char *>(data) + indexPageOffset, size - indexPageOffset, MADV_WILLNEED);
+    }
+
+    void ContentBundle::validate() const {
+        const Header &bundleHeader = header();
+
+        if (memcmp(bundleHeader.magic, MAGIC, sizeof(MAGIC)) != 0 || bundleHeader.version != VERSION) {
+            throw BundleFormatException{};
+        }
+
+        uint64_t bucketCount = bundleHeader.bucketCount;
+
+        if (bucketCount == 0 || (bucketCount & (bucketCount - 1)) != 0 ||
+            bundleHeader.indexOffset % alignof(Entry) != 0 || bundleHeader.indexOffset > size ||
+            bucketCount > (size - bundleHeader.indexOffset) / sizeof(Entry)) {
+            throw BundleFormatException{};
+        }
+
+        auto isInside = [this](uint64_t offset, uint64_t length) {
+            return offset <= size && length <= size - offset;
+        };
+
+        bool hasEmptySlot = false;
+
+        for (uint64_t i = 0; i < bucketCount; i++) {
+            const Entry &entry = entries()[i];
+
+            if (entry.pathLength == 0) {
+                hasEmptySlot = true;
+            } else if (!isInside(entry.pathOffset, entry.pathLength) ||
+                       !isInside(entry.bodyOffset, entry.bodySize) ||
+                       !isInside(entry.gzipBodyOffset, entry.gzipBodySize)) {
+                throw BundleFormatException{};
+            }
+        }
+
+        /* Lookups stop at the first empty slot. */
+        if (!hasEmptySlot) {
+            throw BundleFormatException{};
+        }
+    }
+
+    const ContentBundle::Entry *ContentBundle::find(std::string_view path) const {
+        uint64_t pathHash = hash(path);
+        uint64_t mask = header().bucketCount - 1;
+
+        for (uint64_t i = pathHash & mask;; i = (i + 1) & mask) {
+            const Entry &entry = entries()[i];
+
+            if (entry.pathLength == 0) {
+                return nullptr;
+            }
+
+            if (entry.pathHash == pathHash && entry.pathLength == path.size() &&
+                memcmp(data + entry.pathOffset, path.data(), path.size()) == 0) {
+                return &entry;
+            }
+        }
+    }
+
+    void ContentBundle::pack(const fs::path &rootDirectory, const fs::path &bundlePath) {
+        fs::path root = fs::canonical(rootDirectory);
+
+        std::vector<fs::path> filePaths;
+
+        for (const auto &item : fs::recursive_directory_iterator(root, fs::directory_options::skip_permission_denied)) {
+            if (!item.is_regular_file() || !isWithin(root, fs::canonical(item.path()))) {
+                continue;
+            }
+
+            /* Previous version of the bundle may lie in the packed directory. */
+            if (fs::exists(bundlePath) && fs::equivalent(item.path(), bundlePath)) {
+                continue;
+            }
+
+            filePaths.push_back(item.path());
+        }
+
+        /* Files from the same directory end up next to each other in the bundle. */
+        std::sort(filePaths.begin(), filePaths.end());
+
+        /* Bundle is written aside and renamed, as the server may have the old one mapped. */
+        fs::path temporaryPath = bundlePath;
+        temporaryPath += ".tmp";
+
+        int bundleDescriptor = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+        if (bundleDescriptor < 0) {
+            throw BundleWriteException{};
+        }
+
+        try {
+            Header bundleHeader{};
+            writeAll(bundleDescriptor, &bundleHeader, sizeof(bundleHeader));
+
+            uint64_t offset = sizeof(bundleHeader);
+
+            std::vector<std::string> relativePaths;
+            std::vector<Entry> packedEntries;
+
+            for (const auto &filePath : filePaths) {
+                Entry entry{};
+
+                auto [bodySize, contentHash] = appendFile(bundleDescriptor, filePath);
+                entry.bodyOffset = offset;
+                entry.bodySize = bodySize;
+                entry.contentHash = contentHash;
+                offset += bodySize;
+
+                fs::path gzipPath = filePath;
+                gzipPath += ".gz";
+
+                if (fs::is_regular_file(gzipPath)) {
+                    entry.gzipBodyOffset = offset;
+                    entry.gzipBodySize = appendFile(bundleDescriptor, gzipPath).first;
+                    offset += entry.gzipBodySize;
+                }
+
+                /* Epoch of the file clock is unspecified, HTTP dates count from the Unix one. */
+                entry.modificationTime = std::chrono::duration_cast<std::chrono::seconds>(
+                        std::chrono::file_clock::to_sys(fs::last_write_time(filePath)).time_since_epoch()).count();
+
+                relativePaths.push_back("/" + filePath.lexically_relative(root).generic_string());
+                packedEntries.push_back(entry);
+            }
+
+            for (size_t i = 0; i < packedEntries.size(); i++) {
+                const std::string &path = relativePaths[i];
+
+                writeAll(bundleDescriptor, path.data(), path.size());
+
+                packedEntries[i].pathHash = hash(path);
+                packedEntries[i].pathOffset = offset;
+                packedEntries[i].pathLength = path.size();
+                offset += path.size();
+            }
+
+            char padding[alignof(Entry)]{};
+            uint64_t paddingSize = (alignof(Entry) - offset % alignof(Entry)) % alignof(Entry);
+            writeAll(bundleDescriptor, padding, paddingSize);
+            offset += paddingSize;
+
+            /* Load factor of at most one half keeps probe sequences short. */
+            uint64_t bucketCount = 1;
+            while (bucketCount < 2 * packedEntries.size() + 1) {
+                bucketCount *= 2;
+            }
+
+            std::vector<Entry> buckets(bucketCount);
+
+            for (const Entry &entry : packedEntries) {
+                uint64_t i = entry.pathHash & (bucketCount - 1);
+
+                while (buckets[i].pathLength != 0) {
+                    i = (i + 1) & (bucketCount - 1);
+                }
+
+                buckets[i] = entry;
+            }
+
+            writeAll(bundleDescriptor, buckets.data(), buckets.size() * sizeof(Entry));
+
+            memcpy(bundleHeader.magic, MAGIC, sizeof(MAGIC));
+            bundleHeader.version = VERSION;
+            bundleHeader.bucketCount = bucketCount;
+            bundleHeader.indexOffset = offset;
+
+            if (pwrite(bundleDescriptor, &bundleHeader, sizeof(bundleHeader), 0) !=
+                static_cast<ssize_t>(sizeof(bundleHeader)) || fsync(bundleDescriptor) < 0) {
+                throw BundleWriteException{};
+            }
+        } catch (...) {
+            close(bundleDescriptor);
+            unlink(temporaryPath.c_str());
+            throw;
+        }
+
+        if (close(bundleDescriptor) < 0 || rename(temporaryPath.c_str(), bundlePath.c_str()) < 0) {
+            unlink(temporaryPath.c_str());
+            throw BundleWriteException{};
+        }
+    }
+}
@@ -0,0 +1,133 @@
+#ifndef SIKZAD1_CONTENTBUNDLE_H
+#define SIKZAD1_CONTENTBUNDLE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Auxiliary.h"
+
+namespace SIK {
+    class BundleOpenException : public ServerException {
+    public:
+        [[nodiscard]] const char *what() const noexcept override {
+            return "Opening content bundle has failed!";
+        }
+    };
+
+    class BundleFormatException : public ServerException {
+    public:
+        [[nodiscard]] const char *what() const noexcept override {
+            return "Content bundle is corrupted!";
+        }
+    };
+
+    class BundleWriteException : public ServerException {
+    public:
+        [[nodiscard]] const char *what() const noexcept override {
+            return "Writing content bundle has failed!";
+        }
+    };
+
+    /* Contents of a files directory packed into a single file, served without touching
+     * the directory. Bundle consists of (all numbers in native byte order):
+     *   - header,
+     *   - bodies of the files, one after another,
+     *   - paths of the files relative to the root, starting with '/',
+     *   - hash table of entries indexed by FNV-1a hash of the path, with linear probing.
+     * Slots of the hash table without entry have zero pathLength. */
+    class ContentBundle {
+    public:
+        static constexpr char MAGIC[8] = {'S', 'I', 'K', 'B', 'N', 'D', 'L', '\0'};
+        static constexpr uint32_t VERSION = 2;
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t reserved;
+            uint64_t bucketCount;
+            uint64_t indexOffset;
+        };
+
+        struct Entry {
+            uint64_t pathHash;
+            uint64_t pathOffset;
+            uint64_t pathLength;
+            uint64_t bodyOffset;
+            uint64_t bodySize;
+
+            /* Body of file.gz found next to the file, zero size if there was none. */
+            uint64_t gzipBodyOffset;
+            uint64_t gzipBodySize;
+
+            /* Validators of the file: modification time in seconds since the Unix epoch and hash of the body. */
+            int64_t modificationTime;
+            uint64_t contentHash;
+        };
+
+        /* Maps bundle into memory. */
+        explicit ContentBundle(const std::filesystem::path &bundlePath);
+
+        /* Unmaps and closes bundle. */
+        ~ContentBundle() {
+            munmap(const_cast<char *>(data), size);
+            close(descriptor);
+        }
+
+        ContentBundle(const ContentBundle &) = delete;
+
+        ContentBundle &operator=(const ContentBundle &) = delete;
+
+        /* Returns entry of the file with given path relative to the root, nullptr if there is none. */
+        [[nodiscard]] const Entry *find(std::string_view path) const;
+
+        /* Returns descriptor of the bundle, from which bodies are sent. */
+        [[nodiscard]] int getDescriptor() const {
+            return descriptor;
+        }
+
+        /* Packs all regular files from rootDirectory into bundle at bundlePath. */
+        static void pack(const std::filesystem::path &rootDirectory, const std::filesystem::path &bundlePath);
+
+        /* Returns 64-bit FNV-1a hash of the data. */
+        static uint64_t hash(std::string_view data, uint64_t seed = FNV_OFFSET_BASIS) {
+            for (unsigned char ch : data) {
+                seed ^= ch;
+                seed *= FNV_PRIME;
+            }
+
+            return seed;
+        }
+
+    private:
+        static constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+        static constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+        [[nodiscard]] const Entry *entries() const {
+            return reinterpret_cast<const Entry *>(data + header().indexOffset);
+        }
+
+        [[nodiscard]] const Header &header() const {
+            return *reinterpret_cast<const Header *>(data);
+        }
+
+        /* Checks that all offsets in the bundle point inside of it. */
+        void validate() const;
+
+        /* Descriptor of the bundle file. */
+        int descriptor;
+
+        /* Mapped bundle. */
+        const char *data;
+
+        /* Size of the bundle. */
+        size_t size;
+    };
+}
+
+#endif //SIKZAD1_CONTENTBUNDLE_H
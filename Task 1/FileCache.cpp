@@ -0,0 +1,371 @@
+#include "FileCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+
+namespace {
+    namespace fs = std::filesystem;
+
+    /* Lists regular files below the root directory, walking directories on multiple threads. */
+    std::vector<fs::path> listFiles(const fs::path &rootDirectory, unsigned threadCount) {
+        std::vector<fs::path> directories{rootDirectory};
+        std::vector<fs::path> filePaths;
+
+        std::mutex mutex;
+        std::condition_variable directoryAdded;
+        unsigned busyWorkers = 0;
+
+        auto worker = [&]() {
+            std::unique_lock lock{mutex};
+
+            while (true) {
+                directoryAdded.wait(lock, [&]() { return !directories.empty() || busyWorkers == 0; });
+
+                if (directories.empty()) {
+                    return;
+                }
+
+                fs::path directory = std::move(directories.back());
+                directories.pop_back();
+                busyWorkers++;
+
+                lock.unlock();
+
+                std::vector<fs::path> foundDirectories;
+                std::vector<fs::path> foundFiles;
+                std::error_code error;
+
+                for (fs::directory_iterator it{directory, fs::directory_options::skip_permission_denied, error}, end;
+                     !error && it != end; it.increment(error)) {
+                    /* Symbolic links to directories are not followed, as they may form cycles. */
+                    if (it->is_directory(error) && !it->is_symlink(error)) {
+                        foundDirectories.push_back(it->path());
+                    } else if (it->is_regular_file(error)) {
+                        foundFiles.push_back(it->path());
+                    }
+                }
+
+                lock.lock();
+
+                busyWorkers--;
+                directories.insert(directories.end(), foundDirectories.begin(), foundDirectories.end());
+                filePaths.insert(filePaths.end(), foundFiles.begin(), foundFiles.end());
+
+                directoryAdded.notify_all();
+            }
+        };
+
+        std::vector<std::thread> threads;
+
+        for (unsigned i = 0; i < threadCount; i++) {
+            threads.emplace_back(worker);
+        }
+
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        return filePaths;
+    }
+}
+
+namespace SIK {
+    FileCache::FileCache(const fs::path &rootDirectory, size_t capacity, const std::string &manifestPath)
+            : rootDirectory{rootDirectory}, capacity{capacity}, manifestPath{manifestPath} {
+        /* Half of the descriptors is left for clients. */
+        rlimit descriptorLimit{};
+
+        if (getrlimit(RLIMIT_NOFILE, &descriptorLimit) == 0 && descriptorLimit.rlim_cur != RLIM_INFINITY) {
+            this->capacity = std::min<size_t>(capacity, descriptorLimit.rlim_cur / 2);
+        }
+
+        if (manifestPath.empty()) {
+            return;
+        }
+
+        /* Missing or broken manifest only means there is nothing to prefetch. */
+        std::ifstream manifest{manifestPath};
+
+        uint64_t hits;
+        std::string resource;
+
+        while (manifest >> hits && manifest.get() == ' ' && std::getline(manifest, resource)) {
+            hotResources.push_back(std::move(resource));
+        }
+    }
+
+    const FileCache::File *FileCache::find(const std::string &resource) {
+        auto it = files.find(resource);
+
+        if (it == files.end()) {
+            return nullptr;
+        }
+
+        File &file = it->second;
+
+        auto now = std::chrono::steady_clock::now();
+
+        if (now - file.validatedAt > VALIDITY_PERIOD) {
+            struct stat fileStat{};
+
+            if (stat(file.absolutePath.c_str(), &fileStat) < 0 || fileStat.st_dev != file.device ||
+                fileStat.st_ino != file.inode || !S_ISREG(fileStat.st_mode)) {
+                erase(it);
+                return nullptr;
+            }
+
+            file.size = fileStat.st_size;
+            file.validatedAt = now;
+        }
+
+        (*file.hits)++;
+        recency.splice(recency.begin(), recency, file.recencyPosition);
+
+        return &file;
+    }
+
+    const FileCache::File *FileCache::add(const std::string &resource, const fs::path &absolutePath) {
+        if (capacity == 0) {
+            return nullptr;
+        }
+
+        File file{absolutePath, nullptr, 0, 0, 0, {}, nullptr, {}};
+
+        if (!open(absolutePath, file)) {
+            return nullptr;
+        }
+
+        auto it = files.find(resource);
+
+        if (it != files.end()) {
+            erase(it);
+        } else if (files.size() >= capacity) {
+            erase(files.find(*recency.back()));
+        }
+
+        File &cachedFile = insert(resource, std::move(file), true);
+        (*cachedFile.hits)++;
+
+        return &cachedFile;
+    }
+
+    FileCache::File &FileCache::insert(std::string resource, File &&file, bool mostRecent) {
+        if (!hitCounts.contains(resource) && hitCounts.size() >= std::max(MAX_HIT_COUNTS, 2 * capacity)) {
+            ageHitCounts();
+        }
+
+        file.hits = &hitCounts[resource];
+
+        auto it = files.emplace(std::move(resource), std::move(file)).first;
+
+        /* Keys of the map stay in place until their entries are erased. */
+        it->second.recencyPosition = recency.insert(mostRecent ? recency.begin() : recency.end(), &it->first);
+
+        return it->second;
+    }
+
+    void FileCache::erase(std::unordered_map<std::string, File>::iterator it) {
+        recency.erase(it->second.recencyPosition);
+        files.erase(it);
+    }
+
+    void FileCache::ageHitCounts() {
+        /* Counts of cached files are never removed, as the files point to them. There are
+         * at most half as many of them as the limit, so some room is always freed. */
+        while (hitCounts.size() >= std::max(MAX_HIT_COUNTS, 2 * capacity)) {
+            for (auto it = hitCounts.begin(); it != hitCounts.end();) {
+                it->second /= 2;
+
+                if (it->second == 0 && !files.contains(it->first)) {
+                    it = hitCounts.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    bool FileCache::open(const fs::path &absolutePath, File &file) {
+        int descriptor = ::open(absolutePath.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (descriptor < 0) {
+            return false;
+        }
+
+        struct stat fileStat{};
+
+        if (fstat(descriptor, &fileStat) < 0 || !S_ISREG(fileStat.st_mode)) {
+            close(descriptor);
+            return false;
+        }
+
+        file.openFile = std::make_shared<const OpenFile>(descriptor);
+        file.size = fileStat.st_size;
+        file.device = fileStat.st_dev;
+        file.inode = fileStat.st_ino;
+        file.validatedAt = std::chrono::steady_clock::now();
+
+        return true;
+    }
+
+    std::vector<FileCache::WarmFile> FileCache::scan() const {
+        unsigned threadCount = std::clamp(std::thread::hardware_concurrency(), 1u, MAX_WARM_UP_THREADS);
+
+        std::vector<WarmFile> warmFiles;
+
+        for (const auto &filePath : listFiles(rootDirectory, threadCount)) {
+            std::string resource = "/" + filePath.lexically_relative(rootDirectory).generic_string();
+            warmFiles.push_back({std::move(resource), {filePath, nullptr, 0, 0, 0, {}, nullptr, {}}});
+        }
+
+        std::unordered_map<std::string, size_t> hotness;
+
+        for (size_t i = 0; i < hotResources.size(); i++) {
+            hotness.emplace(hotResources[i], i);
+        }
+
+        /* Hottest files go first, so that they are the ones cached and prefetched. */
+        std::stable_sort(warmFiles.begin(), warmFiles.end(), [&hotness](const WarmFile &a, const WarmFile &b) {
+            auto aIt = hotness.find(a.resource);
+            auto bIt = hotness.find(b.resource);
+
+            auto aRank = aIt == hotness.end() ? SIZE_MAX : aIt->second;
+            auto bRank = bIt == hotness.end() ? SIZE_MAX : bIt->second;
+
+            return aRank < bRank;
+        });
+
+        if (warmFiles.size() > capacity) {
+            warmFiles.resize(capacity);
+        }
+
+        std::atomic<size_t> nextFile = 0;
+        std::atomic<uintmax_t> prefetchedBytes = 0;
+
+        auto worker = [&]() {
+            for (size_t i = nextFile++; i < warmFiles.size(); i = nextFile++) {
+                File &file = warmFiles[i].file;
+
+                std::error_code error;
+                fs::path absolutePath = fs::canonical(file.absolutePath, error);
+
+                if (error || !isWithin(rootDirectory, absolutePath) || !open(absolutePath, file)) {
+                    continue;
+                }
+
+                file.absolutePath = std::move(absolutePath);
+
+                if (hotness.contains(warmFiles[i].resource) &&
+                    (prefetchedBytes += file.size) <= PREFETCH_BUDGET) {
+                    posix_fadvise(file.openFile->descriptor, 0, 0, POSIX_FADV_WILLNEED);
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+
+        for (unsigned i = 0; i < threadCount; i++) {
+            threads.emplace_back(worker);
+        }
+
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        std::erase_if(warmFiles, [](const WarmFile &warmFile) { return !warmFile.file.openFile; });
+
+        return warmFiles;
+    }
+
+    void FileCache::adopt(std::vector<WarmFile> &&warmFiles) {
+        for (auto &[resource, file] : warmFiles) {
+            /* Files requested during background warm-up are already cached. */
+            if (files.size() >= capacity || files.contains(resource)) {
+                continue;
+            }
+
+            /* Files come hottest first, behind the ones requested in the meantime. */
+            insert(std::move(resource), std::move(file), false);
+        }
+    }
+
+    void FileCache::warmUp() {
+        std::cout << "Warming up file cache." << std::endl;
+
+        adopt(scan());
+
+        std::cout << "File cache is warm, " << files.size() << " files cached." << std::endl;
+    }
+
+    Task<void> FileCache::warmUpInBackground(Scheduler &scheduler) {
+        std::cout << "Warming up file cache in background." << std::endl;
+
+        int doneDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (doneDescriptor < 0) {
+            throw SchedulerWaitException{};
+        }
+
+        std::vector<WarmFile> warmFiles;
+
+        std::thread scanner{[this, &warmFiles, doneDescriptor]() {
+            warmFiles = scan();
+
+            uint64_t done = 1;
+            write(doneDescriptor, &done, sizeof(done));
+        }};
+
+        co_await scheduler.readable(doneDescriptor);
+
+        scanner.join();
+        scheduler.forget(doneDescriptor);
+        close(doneDescriptor);
+
+        adopt(std::move(warmFiles));
+
+        std::cout << "File cache is warm, " << files.size() << " files cached." << std::endl;
+    }
+
+    void FileCache::saveManifest() const {
+        if (manifestPath.empty()) {
+            return;
+        }
+
+        std::vector<std::pair<uint64_t, const std::string *>> accesses;
+
+        for (const auto &[resource, hits] : hitCounts) {
+            if (hits > 0 && resource.find('\n') == std::string::npos) {
+                accesses.emplace_back(hits, &resource);
+            }
+        }
+
+        std::sort(accesses.begin(), accesses.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+
+        /* Manifest is written aside and renamed, so that a crash never leaves it half written. */
+        std::string temporaryPath = manifestPath + ".tmp";
+
+        {
+            std::ofstream manifest{temporaryPath, std::ios::trunc};
+
+            for (const auto &[hits, resource] : accesses) {
+                manifest << hits << ' ' << *resource << '\n';
+            }
+
+            if (!manifest) {
+                std::cout << "Saving access manifest failed!" << std::endl;
+                return;
+            }
+        }
+
+        if (rename(temporaryPath.c_str(), manifestPath.c_str()) < 0) {
+            std::cout << "Saving access manifest failed!" << std::endl;
+        }
+    }
+}
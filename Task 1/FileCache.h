@@ -0,0 +1,158 @@
+#ifndef SIKZAD1_FILECACHE_H
+#define SIKZAD1_FILECACHE_H
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "Scheduler.h"
+#include "Task.h"
+
+namespace SIK {
+    /* Way of warming up the file cache on startup. */
+    enum class WarmUpMode {
+        NONE,
+
+        /* Server starts listening once the cache is warm. */
+        BLOCKING,
+
+        /* Server serves clients while the cache is warmed up. */
+        BACKGROUND
+    };
+
+    /* Cache of resolved paths, metadata and open descriptors of files from the root directory.
+     * Entries are revalidated against the file system every VALIDITY_PERIOD, so that replaced
+     * files are picked up. When full, the least recently used file is evicted. Cache remembers
+     * how often files are requested, evicted ones included, and can save it as an access manifest,
+     * used by the next process to prefetch the hottest files first. */
+    class FileCache {
+    public:
+        /* Descriptor of an open file, closed once nobody uses it. Requests keep the file
+         * open while sending it, even if the cache drops it in the meantime. */
+        class OpenFile {
+        public:
+            explicit OpenFile(int descriptor) : descriptor{descriptor} {}
+
+            ~OpenFile() {
+                close(descriptor);
+            }
+
+            OpenFile(const OpenFile &) = delete;
+
+            OpenFile &operator=(const OpenFile &) = delete;
+
+            const int descriptor;
+        };
+
+        struct File {
+            /* Canonical path of the file. */
+            std::filesystem::path absolutePath;
+
+            std::shared_ptr<const OpenFile> openFile;
+            uintmax_t size;
+            dev_t device;
+            ino_t inode;
+
+            /* Last time the entry has been checked against the file system. */
+            std::chrono::steady_clock::time_point validatedAt;
+
+            /* How many times the file has been requested, kept in hitCounts. */
+            uint64_t *hits = nullptr;
+
+            /* Position of the entry in the recency list. */
+            std::list<const std::string *>::iterator recencyPosition;
+        };
+
+        /* Creates empty cache for up to capacity files and loads access manifest, if there is one. */
+        FileCache(const std::filesystem::path &rootDirectory, size_t capacity, const std::string &manifestPath);
+
+        FileCache(const FileCache &) = delete;
+
+        FileCache &operator=(const FileCache &) = delete;
+
+        /* Returns cached file for the resource, nullptr if it is not cached.
+         * Resources are expected to be lexically normal, so that aliases share the entry. */
+        const File *find(const std::string &resource);
+
+        /* Opens file with given canonical path and caches it for the resource.
+         * Returns nullptr if the file cannot be opened. */
+        const File *add(const std::string &resource, const std::filesystem::path &absolutePath);
+
+        /* Scans root directory in parallel and fills the cache, hottest files from the manifest first. */
+        void warmUp();
+
+        /* Same as warmUp(), but the scan runs on other threads while the event loop keeps going. */
+        Task<void> warmUpInBackground(Scheduler &scheduler);
+
+        /* Saves how often cached files have been requested. */
+        void saveManifest() const;
+
+    private:
+        /* How long the entry is trusted without checking the file system. */
+        static constexpr std::chrono::seconds VALIDITY_PERIOD{1};
+
+        /* How many bytes of the hottest files are prefetched into the page cache. */
+        static constexpr uintmax_t PREFETCH_BUDGET = 256 * 1024 * 1024;
+
+        /* Maximum amount of threads scanning the root directory. */
+        static constexpr unsigned MAX_WARM_UP_THREADS = 16;
+
+        /* Maximum amount of resources whose hit counts are kept, unless the cache is larger. */
+        static constexpr size_t MAX_HIT_COUNTS = 65536;
+
+        /* File opened by warm-up, not inserted into the cache yet. */
+        struct WarmFile {
+            std::string resource;
+            File file;
+        };
+
+        /* Returns files from the root directory, hottest first, opened and prefetched. Thread safe. */
+        [[nodiscard]] std::vector<WarmFile> scan() const;
+
+        /* Inserts files opened by warm-up into the cache. */
+        void adopt(std::vector<WarmFile> &&warmFiles);
+
+        /* Opens the file and fills its metadata. Returns false if it cannot be opened. */
+        static bool open(const std::filesystem::path &absolutePath, File &file);
+
+        /* Inserts file for the resource, which is not cached, as the most or the least recently used one. */
+        File &insert(std::string resource, File &&file, bool mostRecent);
+
+        /* Removes cached file. */
+        void erase(std::unordered_map<std::string, File>::iterator it);
+
+        /* Halves all hit counts, forgetting resources which are not cached and drop to zero,
+         * until there is room for another resource. */
+        void ageHitCounts();
+
+        std::filesystem::path rootDirectory;
+
+        size_t capacity;
+
+        std::string manifestPath;
+
+        /* Resources from the access manifest, hottest first. */
+        std::vector<std::string> hotResources;
+
+        /* Cached files by requested resource. */
+        std::unordered_map<std::string, File> files;
+
+        /* Resources of cached files, the most recently used first. */
+        std::list<const std::string *> recency;
+
+        /* How many times each resource has been served from the cache. It outlives
+         * evicted entries, so that the manifest ranks files by all their requests. */
+        std::unordered_map<std::string, uint64_t> hitCounts;
+    };
+}
+
+#endif //SIKZAD1_FILECACHE_H
@@ -0,0 +1,353 @@
+#include "HPACK.h"
+
+#include <iterator>
+
+namespace {
+    using SIK::HeaderField;
+
+    /* Static table of RFC 7541, Appendix A. */
+    const HeaderField STATIC_TABLE[] = {
+            {":authority", ""}, {":method", "GET"}, {":method", "POST"}, {":path", "/"},
+            {":path", "/index.html"}, {":scheme", "http"}, {":scheme", "https"}, {":status", "200"},
+            {":status", "204"}, {":status", "206"}, {":status", "304"}, {":status", "400"},
+            {":status", "404"}, {":status", "500"}, {"accept-charset", ""}, {"accept-encoding", "gzip, deflate"},
+            {"accept-language", ""}, {"accept-ranges", ""}, {"accept", ""}, {"access-control-allow-origin", ""},
+            {"age", ""}, {"allow", ""}, {"authorization", ""}, {"cache-control", ""},
+            {"content-disposition", ""}, {"content-encoding", ""}, {"content-language", ""}, {"content-length", ""},
+            {"content-location", ""}, {"content-range", ""}, {"content-type", ""}, {"cookie", ""},
+            {"date", ""}, {"etag", ""}, {"expect", ""}, {"expires", ""},
+            {"from", ""}, {"host", ""}, {"if-match", ""}, {"if-modified-since", ""},
+            {"if-none-match", ""}, {"if-range", ""}, {"if-unmodified-since", ""}, {"last-modified", ""},
+            {"link", ""}, {"location", ""}, {"max-forwards", ""}, {"proxy-authenticate", ""},
+            {"proxy-authorization", ""}, {"range", ""}, {"referer", ""}, {"refresh", ""},
+            {"retry-after", ""}, {"server", ""}, {"set-cookie", ""}, {"strict-transport-security", ""},
+            {"transfer-encoding", ""}, {"user-agent", ""}, {"vary", ""}, {"via", ""},
+            {"www-authenticate", ""}
+    };
+
+    constexpr uint64_t STATIC_TABLE_SIZE = std::size(STATIC_TABLE);
+
+    /* Size of a field in the dynamic table, as defined by RFC 7541. */
+    constexpr size_t FIELD_OVERHEAD = 32;
+
+    /* Symbol ending Huffman encoded string, which must never appear in it. */
+    constexpr int EOS_SYMBOL = 256;
+
+    struct HuffmanCode {
+        uint32_t code;
+        uint8_t length;
+    };
+
+    /* Huffman codes of RFC 7541, Appendix B, indexed by symbol. */
+    constexpr HuffmanCode HUFFMAN_CODES[] = {
+            {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28}, {0xfffffe4, 28}, {0xfffffe5, 28},
+            {0xfffffe6, 28}, {0xfffffe7, 28}, {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+            {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28}, {0xfffffed, 28}, {0xfffffee, 28},
+            {0xfffffef, 28}, {0xffffff0, 28}, {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+            {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28}, {0xffffff8, 28}, {0xffffff9, 28},
+            {0xffffffa, 28}, {0xffffffb, 28}, {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+            {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11}, {0x3fa, 10}, {0x3fb, 10},
+            {0xf9, 8}, {0x7fb, 11}, {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+            {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6}, {0x1a, 6}, {0x1b, 6},
+            {0x1c, 6}, {0x1d, 6}, {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+            {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10}, {0x1ffa, 13}, {0x21, 6},
+            {0x5d, 7}, {0x5e, 7}, {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+            {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7}, {0x67, 7}, {0x68, 7},
+            {0x69, 7}, {0x6a, 7}, {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+            {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7}, {0xfc, 8}, {0x73, 7},
+            {0xfd, 8}, {0x1ffb, 13}, {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+            {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5}, {0x24, 6}, {0x5, 5},
+            {0x25, 6}, {0x26, 6}, {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+            {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5}, {0x2b, 6}, {0x76, 7},
+            {0x2c, 6}, {0x8, 5}, {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+            {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14},
+            {0x1ffd, 13}, {0xffffffc, 28}, {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+            {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23}, {0x3fffd6, 22}, {0x7fffda, 23},
+            {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+            {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23}, {0xffffee, 24}, {0x7fffe1, 23},
+            {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+            {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24}, {0x3fffda, 22}, {0x1fffdd, 21},
+            {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+            {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21}, {0x3fffdf, 22},
+            {0x7fffeb, 23}, {0x7fffec, 23}, {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+            {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23}, {0xfffea, 20}, {0x3fffe2, 22},
+            {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+            {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22}, {0x7ffff2, 23},
+            {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+            {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19}, {0x1fffe3, 21},
+            {0x3ffffe6, 26}, {0x7ffffe0, 27}, {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+            {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28}, {0x7ffffe3, 27},
+            {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+            {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23}, {0x3fffea, 22}, {0x3fffeb, 22},
+            {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+            {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27}, {0x7ffffe8, 27},
+            {0x7ffffe9, 27}, {0x7ffffea, 27}, {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+            {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26}, {0x3fffffff, 30},
+    };
+
+    /* Node of the Huffman decoding tree. Zero child means there is none, as the root is nobody's child. */
+    struct HuffmanNode {
+        uint16_t children[2];
+        int16_t symbol;
+    };
+
+    /* Returns Huffman decoding tree, built on first use. */
+    const std::vector<HuffmanNode> &huffmanTree() {
+        static const std::vector<HuffmanNode> tree = []() {
+            std::vector<HuffmanNode> nodes{{{0, 0}, -1}};
+
+            for (int symbol = 0; symbol <= EOS_SYMBOL; symbol++) {
+                auto [code, length] = HUFFMAN_CODES[symbol];
+                size_t node = 0;
+
+                for (int bit = length - 1; bit >= 0; bit--) {
+                    unsigned direction = (code >> bit) & 1;
+
+                    if (nodes[node].children[direction] == 0) {
+                        nodes[node].children[direction] = nodes.size();
+                        nodes.push_back({{0, 0}, -1});
+                    }
+
+                    node = nodes[node].children[direction];
+                }
+
+                nodes[node].symbol = static_cast<int16_t>(symbol);
+            }
+
+            return nodes;
+        }();
+
+        return tree;
+    }
+}
+
+namespace SIK {
+    std::vector<HeaderField> HPACKDecoder::decode(std::string_view block) {
+        std::vector<HeaderField> fields;
+        size_t headerListSize = 0;
+
+        while (!block.empty()) {
+            auto octet = static_cast<uint8_t>(block[0]);
+
+            if (octet & 0x80) {
+                /* Indexed field. */
+                fields.push_back(field(decodeInteger(block, 7)));
+            } else if (octet & 0x40) {
+                /* Literal field with incremental indexing. */
+                fields.push_back(decodeLiteral(block, 6));
+                insert(fields.back());
+            } else if (octet & 0x20) {
+                /* Dynamic table size update. */
+                auto size = decodeInteger(block, 5);
+
+                if (size > DEFAULT_TABLE_SIZE) {
+                    throw HPACKDecodingException{};
+                }
+
+                maxTableSize = size;
+                evict();
+                continue;
+            } else {
+                /* Literal field without indexing or never indexed. */
+                fields.push_back(decodeLiteral(block, 4));
+            }
+
+            headerListSize += fields.back().name.size() + fields.back().value.size() + FIELD_OVERHEAD;
+
+            if (headerListSize > MAX_HEADER_LIST_SIZE) {
+                throw HPACKDecodingException{};
+            }
+        }
+
+        return fields;
+    }
+
+    HeaderField HPACKDecoder::decodeLiteral(std::string_view &block, unsigned prefixBits) const {
+        auto nameIndex = decodeInteger(block, prefixBits);
+
+        std::string name = nameIndex == 0 ? decodeString(block) : field(nameIndex).name;
+        std::string value = decodeString(block);
+
+        return {std::move(name), std::move(value)};
+    }
+
+    uint64_t HPACKDecoder::decodeInteger(std::string_view &block, unsigned prefixBits) {
+        if (block.empty()) {
+            throw HPACKDecodingException{};
+        }
+
+        uint64_t maxPrefix = (1u << prefixBits) - 1;
+        uint64_t value = static_cast<uint8_t>(block[0]) & maxPrefix;
+
+        block.remove_prefix(1);
+
+        if (value < maxPrefix) {
+            return value;
+        }
+
+        /* Values sent by clients never need more than 32 bits. */
+        for (unsigned shift = 0; shift <= 28; shift += 7) {
+            if (block.empty()) {
+                break;
+            }
+
+            auto octet = static_cast<uint8_t>(block[0]);
+            block.remove_prefix(1);
+
+            value += static_cast<uint64_t>(octet & 0x7f) << shift;
+
+            if (!(octet & 0x80)) {
+                return value;
+            }
+        }
+
+        throw HPACKDecodingException{};
+    }
+
+    std::string HPACKDecoder::decodeString(std::string_view &block) {
+        if (block.empty()) {
+            throw HPACKDecodingException{};
+        }
+
+        bool huffmanEncoded = static_cast<uint8_t>(block[0]) & 0x80;
+        auto length = decodeInteger(block, 7);
+
+        if (length > block.size()) {
+            throw HPACKDecodingException{};
+        }
+
+        std::string_view literal = block.substr(0, length);
+        block.remove_prefix(length);
+
+        return huffmanEncoded ? decodeHuffman(literal) : std::string{literal};
+    }
+
+    std::string HPACKDecoder::decodeHuffman(std::string_view encoded) {
+        const std::vector<HuffmanNode> &tree = huffmanTree();
+
+        std::string decoded;
+        decoded.reserve(encoded.size() * 8 / 5);
+
+        size_t node = 0;
+        unsigned depth = 0;
+        bool onlyOnes = true;
+
+        for (unsigned char octet : encoded) {
+            for (int bit = 7; bit >= 0; bit--) {
+                unsigned direction = (octet >> bit) & 1;
+
+                node = tree[node].children[direction];
+                depth++;
+                onlyOnes = onlyOnes && direction == 1;
+
+                if (tree[node].symbol >= 0) {
+                    if (tree[node].symbol == EOS_SYMBOL) {
+                        throw HPACKDecodingException{};
+                    }
+
+                    decoded.push_back(static_cast<char>(tree[node].symbol));
+
+                    node = 0;
+                    depth = 0;
+                    onlyOnes = true;
+                }
+            }
+        }
+
+        /* String may only be padded with fewer than 8 most significant bits of EOS, which are all ones. */
+        if (depth > 7 || !onlyOnes) {
+            throw HPACKDecodingException{};
+        }
+
+        return decoded;
+    }
+
+    const HeaderField &HPACKDecoder::field(uint64_t index) const {
+        if (index == 0) {
+            throw HPACKDecodingException{};
+        }
+
+        if (index <= STATIC_TABLE_SIZE) {
+            return STATIC_TABLE[index - 1];
+        }
+
+        if (index - STATIC_TABLE_SIZE > dynamicTable.size()) {
+            throw HPACKDecodingException{};
+        }
+
+        return dynamicTable[index - STATIC_TABLE_SIZE - 1];
+    }
+
+    void HPACKDecoder::insert(HeaderField field) {
+        size_t fieldSize = field.name.size() + field.value.size() + FIELD_OVERHEAD;
+
+        /* Field larger than the whole table just empties it. */
+        if (fieldSize > maxTableSize) {
+            dynamicTable.clear();
+            tableSize = 0;
+            return;
+        }
+
+        dynamicTable.push_front(std::move(field));
+        tableSize += fieldSize;
+
+        evict();
+    }
+
+    void HPACKDecoder::evict() {
+        while (tableSize > maxTableSize) {
+            const HeaderField &oldest = dynamicTable.back();
+
+            tableSize -= oldest.name.size() + oldest.value.size() + FIELD_OVERHEAD;
+            dynamicTable.pop_back();
+        }
+    }
+
+    void HPACKEncoder::encode(std::string &block, std::string_view name, std::string_view value) {
+        uint64_t nameIndex = 0;
+
+        for (uint64_t i = 0; i < STATIC_TABLE_SIZE; i++) {
+            if (STATIC_TABLE[i].name != name) {
+                continue;
+            }
+
+            if (STATIC_TABLE[i].value == value) {
+                encodeInteger(block, i + 1, 7, 0x80);
+                return;
+            }
+
+            if (nameIndex == 0) {
+                nameIndex = i + 1;
+            }
+        }
+
+        encodeInteger(block, nameIndex, 4, 0x00);
+
+        if (nameIndex == 0) {
+            encodeInteger(block, name.size(), 7, 0x00);
+            block += name;
+        }
+
+        encodeInteger(block, value.size(), 7, 0x00);
+        block += value;
+    }
+
+    void HPACKEncoder::encodeInteger(std::string &block, uint64_t value, unsigned prefixBits, uint8_t flags) {
+        uint64_t maxPrefix = (1u << prefixBits) - 1;
+
+        if (value < maxPrefix) {
+            block.push_back(static_cast<char>(flags | value));
+            return;
+        }
+
+        block.push_back(static_cast<char>(flags | maxPrefix));
+        value -= maxPrefix;
+
+        while (value >= 128) {
+            block.push_back(static_cast<char>(value % 128 + 128));
+            value /= 128;
+        }
+
+        block.push_back(static_cast<char>(value));
+    }
+}
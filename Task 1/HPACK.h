@@ -0,0 +1,80 @@
+#ifndef SIKZAD1_HPACK_H
+#define SIKZAD1_HPACK_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Auxiliary.h"
+#include "ResponseSink.h"
+
+namespace SIK {
+    class HPACKDecodingException : public ServerException {
+    public:
+        [[nodiscard]] const char *what() const noexcept override {
+            return "Header block sent by the client is malformed!";
+        }
+    };
+
+    /* Decoder of HPACK (RFC 7541) header blocks sent by one client. Fields referring
+     * to the static table are looked up directly, only the rest touch the dynamic table. */
+    class HPACKDecoder {
+    public:
+        /* Default maximum size of the dynamic table, which the server does not change. */
+        static constexpr size_t DEFAULT_TABLE_SIZE = 4096;
+
+        /* Maximum total size of fields in a single header block. */
+        static constexpr size_t MAX_HEADER_LIST_SIZE = 65536;
+
+        /* Decodes header block, updating the dynamic table. Throws HPACKDecodingException
+         * if the block is malformed, after which the decoder is no longer usable. */
+        std::vector<HeaderField> decode(std::string_view block);
+
+    private:
+        /* Decodes literal field, whose name index has prefix of given amount of bits. */
+        HeaderField decodeLiteral(std::string_view &block, unsigned prefixBits) const;
+
+        /* Decodes integer with prefix of given amount of bits. */
+        static uint64_t decodeInteger(std::string_view &block, unsigned prefixBits);
+
+        /* Decodes string literal, Huffman encoded or not. */
+        static std::string decodeString(std::string_view &block);
+
+        /* Decodes Huffman encoded string. */
+        static std::string decodeHuffman(std::string_view encoded);
+
+        /* Returns field with given index of the static or the dynamic table. */
+        [[nodiscard]] const HeaderField &field(uint64_t index) const;
+
+        /* Inserts field into the dynamic table, evicting the oldest fields if needed. */
+        void insert(HeaderField field);
+
+        /* Evicts the oldest fields until the dynamic table fits in its maximum size. */
+        void evict();
+
+        /* Fields of the dynamic table, the newest first. */
+        std::deque<HeaderField> dynamicTable;
+
+        /* Size of the dynamic table as defined by RFC 7541. */
+        size_t tableSize = 0;
+
+        size_t maxTableSize = DEFAULT_TABLE_SIZE;
+    };
+
+    /* Encoder of HPACK header blocks. It does not use the dynamic table, so that blocks
+     * can be encoded by streams independently. Fields from the static table are indexed,
+     * the rest is sent as literals without indexing, with the name indexed if possible. */
+    class HPACKEncoder {
+    public:
+        /* Appends field, with lower case name, to the header block. */
+        static void encode(std::string &block, std::string_view name, std::string_view value);
+
+    private:
+        /* Appends integer with prefix of given amount of bits. First bits of the prefix octet are given in flags. */
+        static void encodeInteger(std::string &block, uint64_t value, unsigned prefixBits, uint8_t flags);
+    };
+}
+
+#endif //SIKZAD1_HPACK_H
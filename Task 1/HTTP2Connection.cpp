@@ -0,0 +1,647 @@
+#include "HTTP2Connection.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    /* Appends number in network byte order, on given amount of bytes. */
+    void appendNumber(std::string &buffer, uint64_t value, unsigned bytes) {
+        for (unsigned i = bytes; i > 0; i--) {
+            buffer.push_back(static_cast<char>((value >> (8 * (i - 1))) & 0xff));
+        }
+    }
+
+    /* Reads number in network byte order, from given amount of bytes. */
+    uint64_t readNumber(const char *data, unsigned bytes) {
+        uint64_t value = 0;
+
+        for (unsigned i = 0; i < bytes; i++) {
+            value = (value << 8) | static_cast<uint8_t>(data[i]);
+        }
+
+        return value;
+    }
+}
+
+namespace SIK {
+    Task<void> HTTP2Stream::sendHead(unsigned status, const char *, const std::vector<HeaderField> &fields) {
+        /* HTTP/2 has no reason phrases. */
+        HPACKEncoder::encode(headerBlock, ":status", std::to_string(status));
+
+        for (const auto &[name, value] : fields) {
+            std::string lowerCaseName = name;
+
+            transform(lowerCaseName.begin(), lowerCaseName.end(), lowerCaseName.begin(),
+                      [](char c) { return tolower(c); });
+
+            /* Connection-specific fields are not allowed in HTTP/2. */
+            if (lowerCaseName == "connection" || lowerCaseName == "keep-alive" ||
+                lowerCaseName == "transfer-encoding") {
+                continue;
+            }
+
+            HPACKEncoder::encode(headerBlock, lowerCaseName, value);
+        }
+
+        co_return;
+    }
+
+    Task<void> HTTP2Stream::sendFileRange(int fileDescriptor, off64_t offset, size_t count) {
+        co_await connection.sendHeaders(*this, count == 0);
+
+        if (count > 0) {
+            co_await connection.sendData(*this, fileDescriptor, offset, count);
+        }
+    }
+
+    Task<void> HTTP2Stream::sendFile(const std::filesystem::path &filePath) {
+        auto fileSize = std::filesystem::file_size(filePath);
+
+        int fileDescriptor = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (fileDescriptor < 0) {
+            throw OpeningFileException{};
+        }
+
+        try {
+            co_await sendFileRange(fileDescriptor, 0, fileSize);
+        } catch (...) {
+            close(fileDescriptor);
+            throw;
+        }
+
+        close(fileDescriptor);
+    }
+
+    Task<void> HTTP2Stream::finish() {
+        if (!ended && !headersSent) {
+            co_await connection.sendHeaders(*this, true);
+        }
+    }
+
+    Task<void> HTTP2Connection::serve(std::string_view bufferedData) {
+        memcpy(buffer, bufferedData.data(), bufferedData.size());
+        bufferEnd = bufferedData.size();
+
+        /* Control frames and responses without body are small writes, which Nagle's algorithm would delay. */
+        client.setNoDelay();
+
+        HTTP2Error error = HTTP2Error::NO_ERROR;
+
+        try {
+            std::string settings;
+            appendNumber(settings, SETTINGS_MAX_CONCURRENT_STREAMS, 2);
+            appendNumber(settings, MAX_CONCURRENT_STREAMS, 4);
+
+            co_await sendFrame(FrameType::SETTINGS, 0, 0, settings);
+            co_await readFrames();
+        } catch (const HTTP2ConnectionException &e) {
+            std::cout << e.what() << std::endl;
+            error = e.error;
+            failed = true;
+        } catch (const std::exception &e) {
+            std::cout << e.what() << std::endl;
+        }
+
+        reading = false;
+        wakeAll(windowQueue);
+
+        /* Client learns which streams are going to be served, so that it can retry the rest elsewhere. */
+        if (!goingAway || failed) {
+            try {
+                co_await sendGoAway(error);
+            } catch (const std::exception &e) {}
+        }
+
+        while (!streams.empty() || announcingGoAway) {
+            co_await QueueAwaiter{finishQueue};
+        }
+    }
+
+    void HTTP2Connection::goAway() {
+        if (std::exchange(goingAway, true)) {
+            return;
+        }
+
+        announcingGoAway = true;
+        scheduler.spawn(announceGoAway());
+    }
+
+    Task<void> HTTP2Connection::announceGoAway() {
+        try {
+            co_await sendGoAway(HTTP2Error::NO_ERROR);
+        } catch (const std::exception &e) {}
+
+        announcingGoAway = false;
+
+        finishGoingAway();
+    }
+
+    void HTTP2Connection::finishGoingAway() {
+        if (!streams.empty() || announcingGoAway) {
+            return;
+        }
+
+        /* Client closes the connection once it has received everything, the frames it sends
+         * in the meantime are read and dropped. Shutting reading down instead would reset
+         * the connection and could lose the end of the responses. */
+        if (goingAway) {
+            client.shutdownWriting();
+        }
+
+        wakeAll(finishQueue);
+    }
+
+    Task<void> HTTP2Connection::readFrames() {
+        bool first = true;
+
+        while (true) {
+            Frame frame = co_await readFrame();
+
+            /* Client preface ends with SETTINGS frame. */
+            if (first && (frame.type != FrameType::SETTINGS || frame.flags & ACK)) {
+                throw HTTP2ConnectionException{HTTP2Error::PROTOCOL_ERROR};
+            }
+
+            first = false;
+
+            /* Header block has to be sent in consecutive frames. */
+            if (continuedStreamIdentifier != 0 && (frame.type != FrameType::CONTINUATION ||
+                                                   frame.streamIdentifier != continuedStreamIdentifier)) {
+                throw HTTP2ConnectionException{HTTP2Error::PROTOCOL_ERROR};
+            }
+
+            switch (frame.type) {
+                case FrameType::DATA:
+                    co_await handleData(frame);
+                    break;
+                case FrameType::HEADERS:
+                    co_await handleHeaders(frame);
+                    break;
+                case FrameType::CONTINUATION:
+                    co_await handleContinuation(frame);
+                    break;
+                case FrameType::RST_STREAM:
+                    handleReset(frame);
+                    break;
+                case FrameType::SETTINGS:
+                    co_await handleSettings(frame);
+                    break;
+                case FrameType::PING:
+                    co_await handlePing(frame);
+                    break;
+                case FrameType::WINDOW_UPDATE:
+                    co_await handleWindowUpdate(frame);
+                    break;
+                case FrameType::PUSH_PROMISE:
+                    throw HTTP2ConnectionException{HTTP2Error::PROTOCOL_ERROR};
+                case FrameType::GOAWAY:
+                    handleGoAway(frame);
+                    break;
+                default:
+                    /* Priorities are not used, unknown frames are ignored. */
+                    break;
+            }
+        }
+    }
+
+    Task<HTTP2Connection::Frame> HTTP2Connection::readFrame() {
+        co_await fill(FRAME_HEADER_SIZE);
+
+        size_t length = readNumber(buffer + bufferBegin, 3);
+
+        if (length > DEFAULT_MAX_FRAME_SIZE) {
+            throw HTTP2ConnectionException{HTTP2Error::FRAME_SIZE_ERROR};
+        }
+
+        co_await fill(FRAME_HEADER_SIZE + length);
+
+        const char *header = buffer + bufferBegin;
+
+        Frame frame{static_cast<FrameType>(header[3]), static_cast<uint8_t>(header[4]),
+                    static_cast<uint32_t>(readNumber(header + 5, 4) & 0x7fffffff),
+                    {header + FRAME_HEADER_SIZE, length}};
+
+        bufferBegin += FRAME_HEADER_SIZE + length;
+
+        co_return frame;
+    }
+
+    Task<void> HTTP2Connection::fill(size_t count) {
+        if (bufferEnd - bufferBegin >= count) {
+            co_return;
+        }
+
+        memmove(buffer, buffer + bufferBegin, bufferEnd - bufferBegin);
+        bufferEnd -= bufferBegin;
+        bufferBegin = 0;
+
+        while (bufferEnd < count) {
+            ssize_t bytesRead = co_await client.readData(buffer + bufferEnd, READ_BUFFER_SIZE - bufferEnd);
+
+            if (bytesRead == 0) {
+                throw ClientDisconnectedException{};
+            }
+
+            bufferEnd += bytesRead;
+        }
+    }
+
+    Task<void> HTTP2Connection::handleData(const Frame &frame) {
+        if (frame.streamIdentifier == 0) {
+            throw HTTP2ConnectionException{HTTP2Error::PROTOCOL_ERROR};
+        }
+
+        /* Request bodies are not used, yet the client has to be let to send further frames. */
+        if (!frame.payload.empty()) {
+            co_await sendWindowUpdate(0, frame.payload.size());
+
+            if (streams.contains(frame.streamIdentifier) && !(frame.flags & END_STREAM)) {
+                co_await sendWindowUpdate(frame.streamIdentifier, frame.payload.size());
+            }
+        }
+    }
+
+    Task<void> HTTP2Connection::handleHeaders(const Frame &frame) {
+        if (frame.streamIdentifier == 0) {
+            throw HTTP2ConnectionException{HTTP2Error::PROTOCOL_ERROR};
+        }
+
+        std::string_view fragment = frame.payload;
+
+        if (frame.flags & PADDED) {
+            if (fragment.empty() || static_cast<uint8_t>(fragment[0]) >= fragment.size()) {
+                throw HTTP2ConnectionException{HTTP2Error::PROTOCOL_ERROR};
+            }
+
+            fragment.remove_suffix(static_cast<uint8_t>(fragment[0]));
+            fragment.remove_prefix(1);
+        }
+
+        if (frame.flags & PRIORITY) {
+            if (fragment.size() < 5) {
+                throw HTTP2ConnectionException{HTTP2Error::PROTOCOL_ERROR};
+            }
+
+            fragment.remove_prefix(5);
+        }
+
+        headerBlock.assign(fragment);
+        continuedStreamIdentifier = frame.streamIdentifier;
+
+        if (frame.flags & END_HEADERS) {
+            co_await openStream();
+        }
+    }
+
+    Task<void> HTTP2Connection::handleContinuation(const Frame &frame) {
+        if (continuedStreamIdentifier == 0) {
+            throw HTTP2ConnectionException{HTTP2Error::PROTOCOL_ERROR};
+        }
+
+        headerBlock += frame.payload;
+
+        if (headerBlock.size() > HPACKDecoder::MAX_HEADER_LIST_SIZE) {
+            throw HTTP2ConnectionException{HTTP2Error::ENHANCE_YOUR_CALM};
+        }
+
+        if (frame.flags & END_HEADERS) {
+            co_await openStream();
+        }
+    }
+
+    void HTTP2Connection::handleReset(const Frame &frame) {
+        if (frame.streamIdentifier == 0) {
+            throw HTTP2ConnectionException{HTTP2Error::PROTOCOL_ERROR};
+        }
+
+        if (frame.payload.size() != 4) {
+            throw HTTP2ConnectionException{HTTP2Error::FRAME_SIZE_ERROR};
+        }
+
+        auto it = streams.find(frame.streamIdentifier);
+
+        if (it != streams.end()) {
+            it->second->reset = true;
+            wakeAll(windowQueue);
+        }
+    }
+
+    Task<void> HTTP2Connection::handleSettings(const Frame &frame) {
+        if (frame.streamIdentifier != 0) {
+            throw HTTP2ConnectionException{HTTP2Error::PROTOCOL_ERROR};
+        }
+
+        if (frame.flags & ACK) {
+            if (!frame.payload.empty()) {
+                throw HTTP2ConnectionException{HTTP2Error::FRAME_SIZE_ERROR};
+            }
+
+            co_return;
+        }
+
+        if (frame.payload.size() % 6 != 0) {
+            throw HTTP2ConnectionException{HTTP2Error::FRAME_SIZE_ERROR};
+        }
+
+        for (size_t i = 0; i < frame.payload.size(); i += 6) {
+            auto identifier = readNumber(frame.payload.data() + i, 2);
+            auto value = static_cast<int64_t>(readNumber(frame.payload.data() + i + 2, 4));
+
+            if (identifier == SETTINGS_INITIAL_WINDOW_SIZE) {
+                if (value > MAX_WINDOW_SIZE) {
+                    throw HTTP2ConnectionException{HTTP2Error::FLOW_CONTROL_ERROR};
+                }
+
+                /* Change applies to windows of all open streams as well. */
+                for (auto &[streamIdentifier, stream] : streams) {
+                    stream->sendWindow += value - initialStreamWindow;
+                }
+
+                initialStreamWindow = value;
+            } else if (identifier == SETTINGS_MAX_FRAME_SIZE) {
+                if (value < static_cast<int64_t>(DEFAULT_MAX_FRAME_SIZE) ||
+                    value > static_cast<int64_t>(MAX_ALLOWED_FRAME_SIZE)) {
+                    throw HTTP2ConnectionException{HTTP2Error::PROTOCOL_ERROR};
+                }
+
+                maxFrameSize = value;
+            }
+        }
+
+        wakeAll(windowQueue);
+
+        co_await sendFrame(FrameType::SETTINGS, ACK, 0, {});
+    }
+
+    Task<void> HTTP2Connection::handlePing(const Frame &frame) {
+        if (frame.streamIdentifier != 0) {
+            throw HTTP2ConnectionException{HTTP2Error::PROTOCOL_ERROR};
+        }
+
+        if (frame.payload.size() != 8) {
+            throw HTTP2ConnectionException{HTTP2Error::FRAME_SIZE_ERROR};
+        }
+
+        if (!(frame.flags & ACK)) {
+            co_await sendFrame(FrameType::PING, ACK, 0, frame.payload);
+        }
+    }
+
+    Task<void> HTTP2Connection::handleWindowUpdate(const Frame &frame) {
+        if (frame.payload.size() != 4) {
+            throw HTTP2ConnectionException{HTTP2Error::FRAME_SIZE_ERROR};
+        }
+
+        auto increment = static_cast<int64_t>(readNumber(frame.payload.data(), 4) & 0x7fffffff);
+
+        if (increment == 0) {
+            throw HTTP2ConnectionException{HTTP2Error::PROTOCOL_ERROR};
+        }
+
+        if (frame.streamIdentifier == 0) {
+            sendWindow += increment;
+
+            if (sendWindow > MAX_WINDOW_SIZE) {
+                throw HTTP2ConnectionException{HTTP2Error::FLOW_CONTROL_ERROR};
+            }
+        } else {
+            auto it = streams.find(frame.streamIdentifier);
+
+            /* Window of a stream whose response has already been sent does not matter. */
+            if (it == streams.end()) {
+                co_return;
+            }
+
+            HTTP2Stream &stream = *it->second;
+            stream.sendWindow += increment;
+
+            if (stream.sendWindow > MAX_WINDOW_SIZE && !stream.reset) {
+                stream.reset = true;
+                co_await sendReset(stream.identifier, HTTP2Error::FLOW_CONTROL_ERROR);
+            }
+        }
+
+        wakeAll(windowQueue);
+    }
+
+    void HTTP2Connection::handleGoAway(const Frame &frame) {
+        if (frame.streamIdentifier != 0) {
+            throw HTTP2ConnectionException{HTTP2Error::PROTOCOL_ERROR};
+        }
+
+        if (frame.payload.size() < 8) {
+            throw HTTP2ConnectionException{HTTP2Error::FRAME_SIZE_ERROR};
+        }
+
+        /* Frames are still read, as open streams need window updates to finish. */
+        goAway();
+    }
+
+    Task<void> HTTP2Connection::openStream() {
+        uint32_t streamIdentifier = std::exchange(continuedStreamIdentifier, 0);
+
+        /* Every block has to be decoded, so that the dynamic table stays in sync with the client. */
+        std::vector<HeaderField> requestFields;
+
+        try {
+            requestFields = decoder.decode(headerBlock);
+        } catch (const HPACKDecodingException &e) {
+            throw HTTP2ConnectionException{HTTP2Error::COMPRESSION_ERROR};
+        }
+
+        /* Trailers of requests are not used. Client retries streams opened after GOAWAY elsewhere. */
+        if (streamIdentifier <= lastStreamIdentifier || goingAway) {
+            co_return;
+        }
+
+        /* Streams opened by clients have odd identifiers. */
+        if (streamIdentifier % 2 == 0) {
+            throw HTTP2ConnectionException{HTTP2Error::PROTOCOL_ERROR};
+        }
+
+        lastStreamIdentifier = streamIdentifier;
+
+        if (streams.size() >= MAX_CONCURRENT_STREAMS) {
+            co_await sendReset(streamIdentifier, HTTP2Error::REFUSED_STREAM);
+            co_return;
+        }
+
+        auto stream = std::make_unique<HTTP2Stream>(*this, streamIdentifier, std::move(requestFields),
+                                                    initialStreamWindow);
+
+        scheduler.spawn(runStream(*stream));
+        streams.emplace(streamIdentifier, std::move(stream));
+    }
+
+    Task<void> HTTP2Connection::runStream(HTTP2Stream &stream) {
+        bool finished = false;
+
+        try {
+            co_await streamHandler(stream);
+            co_await stream.finish();
+
+            finished = true;
+        } catch (const std::exception &e) {
+            std::cout << e.what() << std::endl;
+        }
+
+        /* Client would wait for the rest of the response forever. */
+        if (!finished && !stream.ended && !stream.reset && !failed) {
+            try {
+                co_await sendReset(stream.identifier, HTTP2Error::INTERNAL_ERROR);
+            } catch (const std::exception &e) {}
+        }
+
+        streams.erase(stream.identifier);
+
+        if (streams.empty()) {
+            idleSince = std::chrono::steady_clock::now();
+        }
+
+        finishGoingAway();
+    }
+
+    Task<void> HTTP2Connection::sendHeaders(HTTP2Stream &stream, bool endStream) {
+        auto writerGuard = co_await lockWriter();
+
+        if (stream.reset || failed) {
+            throw HTTP2StreamClosedException{};
+        }
+
+        std::string frames;
+        std::string_view block = stream.headerBlock;
+
+        FrameType type = FrameType::HEADERS;
+        uint8_t flags = endStream ? END_STREAM : 0;
+
+        do {
+            std::string_view fragment = block.substr(0, maxFrameSize);
+            block.remove_prefix(fragment.size());
+
+            appendFrameHeader(frames, fragment.size(), type, flags | (block.empty() ? END_HEADERS : 0),
+                              stream.identifier);
+            frames += fragment;
+
+            type = FrameType::CONTINUATION;
+            flags = 0;
+        } while (!block.empty());
+
+        stream.headersSent = true;
+        stream.ended = endStream;
+
+        co_await client.sendText(frames);
+    }
+
+    Task<void> HTTP2Connection::sendData(HTTP2Stream &stream, int fileDescriptor, off64_t offset, size_t count) {
+        while (count > 0) {
+            while (!stream.reset && !failed && (sendWindow <= 0 || stream.sendWindow <= 0)) {
+                /* Windows grow only by frames from the client. */
+                if (!reading) {
+                    throw HTTP2StreamClosedException{};
+                }
+
+                co_await QueueAwaiter{windowQueue};
+            }
+
+            auto writerGuard = co_await lockWriter();
+
+            if (stream.reset || failed) {
+                throw HTTP2StreamClosedException{};
+            }
+
+            /* Other streams may have used the window up in the meantime. */
+            if (sendWindow <= 0 || stream.sendWindow <= 0) {
+                continue;
+            }
+
+            size_t length = std::min<uint64_t>({count, maxFrameSize, static_cast<uint64_t>(sendWindow),
+                                                static_cast<uint64_t>(stream.sendWindow)});
+
+            std::string frameHeader;
+            appendFrameHeader(frameHeader, length, FrameType::DATA, length == count ? END_STREAM : 0,
+                              stream.identifier);
+
+            sendWindow -= length;
+            stream.sendWindow -= length;
+
+            try {
+                /* Header held back, so that it leaves in one segment with the payload. */
+                co_await client.sendText(frameHeader, true);
+                co_await client.sendFileRange(fileDescriptor, offset, length);
+            } catch (...) {
+                /* Frame may have been sent in part, so nothing more can be sent on the connection. */
+                failed = true;
+                client.shutdownReading();
+                throw;
+            }
+
+            offset += length;
+            count -= length;
+        }
+
+        stream.ended = true;
+    }
+
+    Task<void> HTTP2Connection::sendFrame(FrameType type, uint8_t flags, uint32_t streamIdentifier,
+                                          std::string_view payload) {
+        std::string frame;
+
+        appendFrameHeader(frame, payload.size(), type, flags, streamIdentifier);
+        frame += payload;
+
+        auto writerGuard = co_await lockWriter();
+
+        co_await client.sendText(frame);
+    }
+
+    Task<void> HTTP2Connection::sendReset(uint32_t streamIdentifier, HTTP2Error error) {
+        std::string payload;
+        appendNumber(payload, static_cast<uint32_t>(error), 4);
+
+        co_await sendFrame(FrameType::RST_STREAM, 0, streamIdentifier, payload);
+    }
+
+    Task<void> HTTP2Connection::sendWindowUpdate(uint32_t streamIdentifier, uint32_t increment) {
+        std::string payload;
+        appendNumber(payload, increment, 4);
+
+        co_await sendFrame(FrameType::WINDOW_UPDATE, 0, streamIdentifier, payload);
+    }
+
+    Task<void> HTTP2Connection::sendGoAway(HTTP2Error error) {
+        std::string payload;
+        appendNumber(payload, lastStreamIdentifier, 4);
+        appendNumber(payload, static_cast<uint32_t>(error), 4);
+
+        co_await sendFrame(FrameType::GOAWAY, 0, 0, payload);
+    }
+
+    void HTTP2Connection::releaseWriter() {
+        if (writerQueue.empty()) {
+            writing = false;
+            return;
+        }
+
+        /* Right to write is passed on directly, so that nobody overtakes the waiting coroutine. */
+        scheduler.wake(writerQueue.front());
+        writerQueue.pop_front();
+    }
+
+    void HTTP2Connection::wakeAll(std::deque<std::coroutine_handle<>> &queue) {
+        for (auto handle : queue) {
+            scheduler.wake(handle);
+        }
+
+        queue.clear();
+    }
+
+    void HTTP2Connection::appendFrameHeader(std::string &buffer, size_t length, FrameType type,
+                                            uint8_t flags, uint32_t streamIdentifier) {
+        appendNumber(buffer, length, 3);
+        appendNumber(buffer, static_cast<uint8_t>(type), 1);
+        appendNumber(buffer, flags, 1);
+        appendNumber(buffer, streamIdentifier, 4);
+    }
+}
@@ -0,0 +1,385 @@
+#ifndef SIKZAD1_HTTP2CONNECTION_H
+#define SIKZAD1_HTTP2CONNECTION_H
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Auxiliary.h"
+#include "HPACK.h"
+#include "ResponseSink.h"
+#include "Scheduler.h"
+#include "Task.h"
+#include "TCPSocket.h"
+
+namespace SIK {
+    /* Error codes of HTTP/2 (RFC 9113, section 7). */
+    enum class HTTP2Error : uint32_t {
+        NO_ERROR = 0x0,
+        PROTOCOL_ERROR = 0x1,
+        INTERNAL_ERROR = 0x2,
+        FLOW_CONTROL_ERROR = 0x3,
+        FRAME_SIZE_ERROR = 0x6,
+        REFUSED_STREAM = 0x7,
+        COMPRESSION_ERROR = 0x9,
+        ENHANCE_YOUR_CALM = 0xb
+    };
+
+    class HTTP2ConnectionException : public ServerException {
+    public:
+        explicit HTTP2ConnectionException(HTTP2Error error) : error{error} {}
+
+        [[nodiscard]] const char *what() const noexcept override {
+            return "Client has violated HTTP/2 protocol!";
+        }
+
+        /* Error code sent to the client in GOAWAY frame. */
+        HTTP2Error error;
+    };
+
+    class HTTP2StreamClosedException : public ServerException {
+    public:
+        [[nodiscard]] const char *what() const noexcept override {
+            return "HTTP/2 stream has been closed before the response was sent!";
+        }
+    };
+
+    class HTTP2Connection;
+
+    /* Single request and its response, multiplexed with others on an HTTP/2 connection. */
+    class HTTP2Stream : public ResponseSink {
+    public:
+        HTTP2Stream(HTTP2Connection &connection, uint32_t identifier,
+                    std::vector<HeaderField> requestFields, int64_t sendWindow)
+                : connection{connection}, identifier{identifier},
+                  requestFields{std::move(requestFields)}, sendWindow{sendWindow} {}
+
+        HTTP2Stream(const HTTP2Stream &) = delete;
+
+        HTTP2Stream &operator=(const HTTP2Stream &) = delete;
+
+        /* Returns header fields of the request, pseudo-header fields included. */
+        [[nodiscard]] const std::vector<HeaderField> &getRequestFields() const {
+            return requestFields;
+        }
+
+        /* Encodes the head of the response. It is sent with the body, or alone by finish(). */
+        Task<void> sendHead(unsigned status, const char *reason, const std::vector<HeaderField> &fields) override;
+
+        /* Sends the head, followed by DATA frames whose payloads go straight from the file to the socket. */
+        Task<void> sendFileRange(int fileDescriptor, off64_t offset, size_t count) override;
+
+        Task<void> sendFile(const std::filesystem::path &filePath) override;
+
+        /* Ends the stream, if the response has not ended it yet. */
+        Task<void> finish();
+
+    private:
+        friend class HTTP2Connection;
+
+        HTTP2Connection &connection;
+
+        uint32_t identifier;
+
+        std::vector<HeaderField> requestFields;
+
+        /* Encoded head of the response. */
+        std::string headerBlock;
+
+        /* Amount of bytes the client is ready to receive on this stream. */
+        int64_t sendWindow;
+
+        /* True once HEADERS frame has been sent. */
+        bool headersSent = false;
+
+        /* True once the frame ending the stream has been sent. */
+        bool ended = false;
+
+        /* True once the client has reset the stream. */
+        bool reset = false;
+    };
+
+    /* Server side of an HTTP/2 connection (RFC 9113), started by a client with prior knowledge.
+     * Frames from the client are read by a single coroutine, while every stream is served by
+     * a coroutine of its own. Streams take turns in writing whole frames to the socket, and
+     * bodies are sent in DATA frames as large as flow control lets them. */
+    class HTTP2Connection {
+    public:
+        /* Serves a stream, once its request has been received. */
+        using StreamHandler = std::function<Task<void>(HTTP2Stream &stream)>;
+
+        /* Connection preface starting every HTTP/2 connection. */
+        static constexpr std::string_view CLIENT_PREFACE = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+        HTTP2Connection(const TCPSocket::ClientConnection &client, Scheduler &scheduler, StreamHandler streamHandler)
+                : client{client}, scheduler{scheduler}, streamHandler{std::move(streamHandler)} {}
+
+        HTTP2Connection(const HTTP2Connection &) = delete;
+
+        HTTP2Connection &operator=(const HTTP2Connection &) = delete;
+
+        /* Serves the connection, whose client preface has already been read together with bufferedData.
+         * Returns once the client is gone or has violated the protocol, and all streams are finished. */
+        Task<void> serve(std::string_view bufferedData);
+
+        /* Tells the client that no more streams are going to be served. Streams already opened
+         * are finished, then the connection ends. */
+        void goAway();
+
+        /* Returns true once goAway() has been called. */
+        [[nodiscard]] bool isGoingAway() const noexcept {
+            return goingAway;
+        }
+
+        /* Returns true if the connection has had no open streams for at least given time. */
+        [[nodiscard]] bool hasBeenIdleFor(std::chrono::steady_clock::duration duration) const {
+            return streams.empty() && continuedStreamIdentifier == 0 &&
+                   std::chrono::steady_clock::now() - idleSince >= duration;
+        }
+
+    private:
+        friend class HTTP2Stream;
+
+        enum class FrameType : uint8_t {
+            DATA = 0x0,
+            HEADERS = 0x1,
+            PRIORITY = 0x2,
+            RST_STREAM = 0x3,
+            SETTINGS = 0x4,
+            PUSH_PROMISE = 0x5,
+            PING = 0x6,
+            GOAWAY = 0x7,
+            WINDOW_UPDATE = 0x8,
+            CONTINUATION = 0x9
+        };
+
+        /* Frame flags. */
+        static constexpr uint8_t END_STREAM = 0x1;
+        static constexpr uint8_t ACK = 0x1;
+        static constexpr uint8_t END_HEADERS = 0x4;
+        static constexpr uint8_t PADDED = 0x8;
+        static constexpr uint8_t PRIORITY = 0x20;
+
+        /* Settings used by the server. */
+        static constexpr uint16_t SETTINGS_MAX_CONCURRENT_STREAMS = 0x3;
+        static constexpr uint16_t SETTINGS_INITIAL_WINDOW_SIZE = 0x4;
+        static constexpr uint16_t SETTINGS_MAX_FRAME_SIZE = 0x5;
+
+        static constexpr size_t FRAME_HEADER_SIZE = 9;
+
+        /* Maximum payload of frames, in both directions unless the client allows larger ones. */
+        static constexpr size_t DEFAULT_MAX_FRAME_SIZE = 16384;
+        static constexpr size_t MAX_ALLOWED_FRAME_SIZE = 16777215;
+
+        static constexpr int64_t DEFAULT_WINDOW_SIZE = 65535;
+        static constexpr int64_t MAX_WINDOW_SIZE = 2147483647;
+
+        /* Maximum amount of streams served at the same time, further ones are refused. */
+        static constexpr uint32_t MAX_CONCURRENT_STREAMS = 100;
+
+        /* Size of the buffer for frames read from the client. */
+        static constexpr size_t READ_BUFFER_SIZE = 4 * DEFAULT_MAX_FRAME_SIZE;
+
+        struct Frame {
+            FrameType type;
+            uint8_t flags;
+            uint32_t streamIdentifier;
+            std::string_view payload;
+        };
+
+        /* Awaitable suspending coroutine until it gets woken up from the queue. */
+        class QueueAwaiter {
+        public:
+            explicit QueueAwaiter(std::deque<std::coroutine_handle<>> &queue) : queue{queue} {}
+
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                queue.push_back(handle);
+            }
+
+            void await_resume() const noexcept {}
+
+        private:
+            std::deque<std::coroutine_handle<>> &queue;
+        };
+
+        /* Right to write frames to the client, passed to the next waiting coroutine on destruction. */
+        class WriterGuard {
+        public:
+            explicit WriterGuard(HTTP2Connection &connection) : connection{connection} {}
+
+            ~WriterGuard() {
+                connection.releaseWriter();
+            }
+
+            WriterGuard(const WriterGuard &) = delete;
+
+            WriterGuard &operator=(const WriterGuard &) = delete;
+
+        private:
+            HTTP2Connection &connection;
+        };
+
+        /* Awaitable acquiring the right to write frames, so that frames of different streams never interleave. */
+        class WriterAwaiter {
+        public:
+            explicit WriterAwaiter(HTTP2Connection &connection) : connection{connection} {}
+
+            bool await_ready() const noexcept {
+                return !std::exchange(connection.writing, true);
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                connection.writerQueue.push_back(handle);
+            }
+
+            WriterGuard await_resume() const noexcept {
+                return WriterGuard{connection};
+            }
+
+        private:
+            HTTP2Connection &connection;
+        };
+
+        /* Reads and handles frames until the client goes away. */
+        Task<void> readFrames();
+
+        /* Reads a single frame. Its payload is valid until the next frame is read. */
+        Task<Frame> readFrame();
+
+        /* Reads from the client until at least count bytes are buffered. */
+        Task<void> fill(size_t count);
+
+        Task<void> handleData(const Frame &frame);
+
+        Task<void> handleHeaders(const Frame &frame);
+
+        Task<void> handleContinuation(const Frame &frame);
+
+        void handleReset(const Frame &frame);
+
+        Task<void> handleSettings(const Frame &frame);
+
+        Task<void> handlePing(const Frame &frame);
+
+        Task<void> handleWindowUpdate(const Frame &frame);
+
+        /* Client is going away, streams it has opened are finished before the connection ends. */
+        void handleGoAway(const Frame &frame);
+
+        /* Decodes the complete header block and starts serving the stream it opens. */
+        Task<void> openStream();
+
+        /* Serves the stream and forgets it once it is finished. */
+        Task<void> runStream(HTTP2Stream &stream);
+
+        /* Sends the head of the stream's response in HEADERS frame, followed by CONTINUATION frames if needed. */
+        Task<void> sendHeaders(HTTP2Stream &stream, bool endStream);
+
+        /* Sends count bytes of the file starting at offset in DATA frames, ending the stream. */
+        Task<void> sendData(HTTP2Stream &stream, int fileDescriptor, off64_t offset, size_t count);
+
+        /* Sends single frame with given payload. */
+        Task<void> sendFrame(FrameType type, uint8_t flags, uint32_t streamIdentifier, std::string_view payload);
+
+        Task<void> sendReset(uint32_t streamIdentifier, HTTP2Error error);
+
+        Task<void> sendWindowUpdate(uint32_t streamIdentifier, uint32_t increment);
+
+        Task<void> sendGoAway(HTTP2Error error);
+
+        /* Sends GOAWAY frame requested by goAway(). */
+        Task<void> announceGoAway();
+
+        /* Ends the connection once it is going away and nothing is left to do. */
+        void finishGoingAway();
+
+        /* Returns awaitable acquiring the right to write frames. */
+        WriterAwaiter lockWriter() {
+            return WriterAwaiter{*this};
+        }
+
+        /* Passes the right to write frames to the next waiting coroutine. */
+        void releaseWriter();
+
+        /* Wakes up all coroutines waiting in the queue. */
+        void wakeAll(std::deque<std::coroutine_handle<>> &queue);
+
+        /* Appends frame header to the buffer. */
+        static void appendFrameHeader(std::string &buffer, size_t length, FrameType type,
+                                      uint8_t flags, uint32_t streamIdentifier);
+
+        const TCPSocket::ClientConnection &client;
+
+        Scheduler &scheduler;
+
+        StreamHandler streamHandler;
+
+        HPACKDecoder decoder;
+
+        /* Streams being served, by identifier. */
+        std::unordered_map<uint32_t, std::unique_ptr<HTTP2Stream>> streams;
+
+        /* Identifier of the most recently opened stream. */
+        uint32_t lastStreamIdentifier = 0;
+
+        /* Moment since which no stream has been open. */
+        std::chrono::steady_clock::time_point idleSince = std::chrono::steady_clock::now();
+
+        /* Stream whose header block is continued with CONTINUATION frames, zero if there is none. */
+        uint32_t continuedStreamIdentifier = 0;
+
+        /* Header block being received. */
+        std::string headerBlock;
+
+        /* Amount of bytes the client is ready to receive on the whole connection. */
+        int64_t sendWindow = DEFAULT_WINDOW_SIZE;
+
+        /* Amount of bytes the client is ready to receive on every new stream. */
+        int64_t initialStreamWindow = DEFAULT_WINDOW_SIZE;
+
+        /* Maximum payload of frames accepted by the client. */
+        size_t maxFrameSize = DEFAULT_MAX_FRAME_SIZE;
+
+        /* False once no more frames are read from the client, so flow control windows no longer grow. */
+        bool reading = true;
+
+        /* True after a connection error, when streams must not send anything more. */
+        bool failed = false;
+
+        /* True once goAway() has been called. */
+        bool goingAway = false;
+
+        /* True while GOAWAY frame requested by goAway() is being sent. */
+        bool announcingGoAway = false;
+
+        /* True while some coroutine has the right to write frames. */
+        bool writing = false;
+
+        /* Coroutines waiting for the right to write frames. */
+        std::deque<std::coroutine_handle<>> writerQueue;
+
+        /* Coroutines waiting for flow control windows to grow. */
+        std::deque<std::coroutine_handle<>> windowQueue;
+
+        /* Coroutine waiting for all streams and GOAWAY announcement to finish. */
+        std::deque<std::coroutine_handle<>> finishQueue;
+
+        /* Frames read from the client, not handled yet, lie between bufferBegin and bufferEnd. */
+        char buffer[READ_BUFFER_SIZE];
+        size_t bufferBegin = 0;
+        size_t bufferEnd = 0;
+    };
+}
+
+#endif //SIKZAD1_HTTP2CONNECTION_H
@@ -20,84 +20,361 @@ namespace {
         ltrim(s);
         rtrim(s);
     }
+
+    /* Returns true if Accept-Encoding field value allows gzip coding. */
+    bool isGzipAccepted(const std::string &acceptEncodingFieldValue) {
+        std::istringstream stream{acceptEncodingFieldValue};
+        std::string coding;
+
+        while (std::getline(stream, coding, ',')) {
+            auto parametersPosition = coding.find(';');
+            std::string parameters = parametersPosition == std::string::npos ? "" : coding.substr(parametersPosition);
+
+            coding = coding.substr(0, parametersPosition);
+            trim(coding);
+            parameters.erase(std::remove(parameters.begin(), parameters.end(), ' '), parameters.end());
+
+            if ((coding == "gzip" || coding == "*") && parameters != ";q=0" && parameters != ";q=0.0" &&
+                parameters != ";q=0.00" && parameters != ";q=0.000") {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /* Formats Unix time as HTTP date (RFC 9110, section 5.6.7). */
+    std::string formatHTTPDate(int64_t unixTime) {
+        time_t time = unixTime;
+        tm calendarTime{};
+        char date[32];
+
+        gmtime_r(&time, &calendarTime);
+        strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &calendarTime);
+
+        return date;
+    }
 }
 
 namespace SIK {
     namespace fs = std::filesystem;
 
     HTTPServer::HTTPServer(const std::string &filesFolderName, const std::string &correlatedServersFileName,
-                           uint16_t portNumber) : correlatedServers{correlatedServersFileName}, socket{portNumber},
-                                                  rootDirectory{filesFolderName}, client{}, lineReader{*this} {
+                           uint16_t portNumber, const ServerOptions &options)
+            : correlatedServers{correlatedServersFileName}, scheduler{}, takeover{options.handoffSocketPath},
+              socket{portNumber, scheduler, options.socketOptions, takeover.listenerDescriptor()},
+              overloadGuard{options.overloadLimits, scheduler, socket, serverName}, rootDirectory{filesFolderName},
+              warmUpMode{options.warmUpMode}, drainTimeout{options.drainTimeout},
+              idleTimeout{options.idleTimeout}, tracer{options.traceOptions} {
 
         rootDirectory = fs::canonical(rootDirectory);
 
-        if (!fs::is_directory(rootDirectory)) {
+        if (fs::is_regular_file(rootDirectory)) {
+            bundle.emplace(rootDirectory);
+        } else if (!fs::is_directory(rootDirectory)) {
             throw RootPathIsNotDirectoryException{};
-        }
+        } else {
+            /* Checking read permission for root directory. */
+            int rootDescriptor = open(rootDirectory.c_str(), O_RDONLY);
 
-        /* Checking read permission for root directory. */
-        int rootDescriptor = open(rootDirectory.c_str(), O_RDONLY);
+            if (rootDescriptor < 0) {
+                throw ReadFromRootDirectoryException{};
+            } else {
+                close(rootDescriptor);
+            }
 
-        if (rootDescriptor < 0) {
-            throw ReadFromRootDirectoryException{};
-        } else {
-            close(rootDescriptor);
+            if (options.fileCacheCapacity > 0 || warmUpMode != WarmUpMode::NONE) {
+                fileCache.emplace(rootDirectory,
+                                  options.fileCacheCapacity > 0 ? options.fileCacheCapacity
+                                                                : DEFAULT_FILE_CACHE_CAPACITY,
+                                  options.accessManifestPath);
+            }
+        }
+
+        if (!options.handoffSocketPath.empty()) {
+            handoff.emplace(options.handoffSocketPath, scheduler);
         }
     }
 
     void HTTPServer::start() {
+        if (fileCache && warmUpMode == WarmUpMode::BLOCKING) {
+            fileCache->warmUp();
+        }
+
+        socket.startListening();
+
         std::cout << "Server has started running and is accepting client connections." << std::endl;
 
+        /* The previous process may stop accepting clients now. */
+        takeover.confirm();
+
+        /* Only a process which has taken over may be taken over from. */
+        if (handoff) {
+            handoff->publish();
+        }
+
+        scheduler.spawn(acceptClients());
+
+        if (handoff) {
+            scheduler.spawn(handleRestart());
+        }
+
+        if (idleTimeout.count() > 0) {
+            scheduler.spawn(closeIdleConnections());
+        }
+
+        if (fileCache && warmUpMode == WarmUpMode::BACKGROUND) {
+            scheduler.spawn(fileCache->warmUpInBackground(scheduler));
+        }
+
+        if (fileCache) {
+            scheduler.spawn(saveAccessManifest());
+        }
+
+        if (tracer.isEnabled()) {
+            scheduler.spawn(exportRequestTraces());
+        }
+
+        scheduler.run();
+    }
+
+    Task<void> HTTPServer::handleRestart() {
+        co_await handoff->handOver(socket.getDescriptor());
+
+        std::cout << "Listening socket handed over, draining " << connections.size() << " connections." << std::endl;
+
+        draining = true;
+        socket.stopListening();
+        handoff.reset();
+
+        /* Connections awaiting the next request would keep the process alive for no reason.
+         * HTTP/2 clients are told which streams are still going to be served and go away. */
+        for (Connection *connection : connections) {
+            if (connection->http2Connection != nullptr) {
+                connection->http2Connection->goAway();
+                continue;
+            }
+
+            connection->closing = true;
+
+            if (connection->idle && !connection->lineReader.hasBufferedData()) {
+                connection->client->shutdownReading();
+            }
+        }
+
+        auto drainDeadline = std::chrono::steady_clock::now() + drainTimeout;
+
+        while (!connections.empty() && std::chrono::steady_clock::now() < drainDeadline) {
+            co_await scheduler.sleep(DRAIN_CHECK_INTERVAL);
+        }
+
+        if (fileCache) {
+            fileCache->saveManifest();
+        }
+
+        tracer.exportChromeTrace();
+
+        std::cout << "Server has been drained, exiting." << std::endl;
+        exit(0);
+    }
+
+    Task<void> HTTPServer::closeIdleConnections() {
         while (true) {
+            co_await scheduler.sleep(IDLE_CHECK_INTERVAL);
+
+            auto now = std::chrono::steady_clock::now();
+
+            /* Pending read of the connection ends as if the client disconnected. */
+            for (Connection *connection : connections) {
+                HTTP2Connection *http2Connection = connection->http2Connection;
+
+                if (http2Connection != nullptr) {
+                    if (!http2Connection->hasBeenIdleFor(idleTimeout)) {
+                        continue;
+                    }
+
+                    /* Client is told to go away first, then it is given until the next check to close. */
+                    if (!http2Connection->isGoingAway()) {
+                        std::cout << "Closing idle HTTP/2 connection." << std::endl;
+                        http2Connection->goAway();
+                    } else {
+                        connection->client->shutdownReading();
+                    }
+                } else if (connection->idle && now - connection->idleSince >= idleTimeout) {
+                    std::cout << "Closing idle connection." << std::endl;
+                    connection->client->shutdownReading();
+                }
+            }
+        }
+    }
+
+    Task<void> HTTPServer::acceptClients() {
+        while (!draining) {
             std::cout << "+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++" << std::endl;
             std::cout << "Awaiting client connection." << std::endl;
 
-            std::unique_ptr<TCPSocket::ClientConnection> uniqueClient;
+            std::vector<std::unique_ptr<TCPSocket::ClientConnection>> clientConnections;
+            bool outOfDescriptors = false;
 
             try {
-                uniqueClient = socket.acceptConnection();
+                clientConnections = co_await socket.acceptConnections();
+            } catch (const ClientSocketLimitException &e) {
+                std::cout << e.what() << std::endl;
+                outOfDescriptors = true;
             } catch (const ClientSocketCreationException &e) {
                 std::cout << e.what() << std::endl;
+            }
+
+            /* Listening socket stays readable, so accepting right away would spin until some descriptor is freed. */
+            if (outOfDescriptors) {
+                co_await scheduler.sleep(ACCEPT_RETRY_DELAY);
                 continue;
             }
 
-            client = uniqueClient.get();
+            for (auto &clientConnection : clientConnections) {
+                if (overloadGuard.isOverloaded()) {
+                    scheduler.spawn(overloadGuard.shed(std::move(clientConnection)));
 
-            std::cout << "Client connection established." << std::endl;
+                    std::cout << "Server is overloaded, client connection rejected." << std::endl;
+                    continue;
+                }
 
-            try {
-                bool keepAlive = true;
+                scheduler.spawn(serveClient(std::move(clientConnection), overloadGuard.trackConnection()));
 
-                while (keepAlive) {
-                    std::cout << "---------------------------------------------------------------" << std::endl;
-                    std::cout << "Getting request from client." << std::endl;
+                std::cout << "Client connection established." << std::endl;
+            }
 
-                    Request request = getRequest();
+            /* Letting clients which are already connected go first. */
+            co_await scheduler.yield();
+        }
+    }
+
+    Task<void> HTTPServer::serveClient(std::unique_ptr<TCPSocket::ClientConnection> clientConnection,
+                                       [[maybe_unused]] OverloadGuard::Tracker connectionTracker) {
+        auto connection = std::make_unique<Connection>(std::move(clientConnection));
 
-                    keepAlive = performRequest(request);
+        if (tracer.isEnabled()) {
+            connection->acceptedAt = TraceClock::now();
+        }
 
-                    std::cout << "Finished performing request." << std::endl;
+        connections.insert(connection.get());
+
+        try {
+            bool keepAlive = true;
+
+            while (keepAlive && !draining) {
+                std::cout << "---------------------------------------------------------------" << std::endl;
+                std::cout << "Getting request from client." << std::endl;
+
+                connection->idle = true;
+                connection->idleSince = std::chrono::steady_clock::now();
+                Request request = co_await getRequest(*connection);
+                connection->idle = false;
+
+                if (request.state == RequestState::HTTP2_PREFACE) {
+                    co_await serveMultiplexed(*connection);
+                    break;
                 }
-            } catch (const std::exception &e) {
-                std::cout << e.what() << std::endl;
+
+                connection->trace.mark(TracePhase::REQUEST_PARSED);
+                connection->trace.setResource(request.file);
+
+                auto requestTracker = overloadGuard.trackRequest();
+                keepAlive = co_await performRequest(*connection, request);
+
+                tracer.finish(connection->trace);
+
+                std::cout << "Finished performing request." << std::endl;
             }
 
-            std::cout << "Connection with client ended." << std::endl;
+            /* Client reads the end of the response and the end of file, instead of a reset. */
+            if (draining) {
+                connection->client->shutdownWriting();
+            }
+        } catch (const std::exception &e) {
+            std::cout << e.what() << std::endl;
         }
+
+        connections.erase(connection.get());
+
+        std::cout << "Connection with client ended." << std::endl;
+    }
+
+    Task<void> HTTPServer::serveMultiplexed(Connection &connection) {
+        std::cout << "Client has switched to HTTP/2." << std::endl;
+
+        HTTP2Connection http2Connection{*connection.client, scheduler, [this](HTTP2Stream &stream) {
+            return serveStream(stream);
+        }};
+
+        connection.http2Connection = &http2Connection;
+
+        /* Server may have started draining while the client was sending the preface. */
+        if (draining) {
+            http2Connection.goAway();
+        }
+
+        co_await http2Connection.serve(connection.lineReader.takeBufferedData());
+
+        connection.http2Connection = nullptr;
+    }
+
+    Task<void> HTTPServer::serveStream(HTTP2Stream &stream) {
+        auto requestTracker = overloadGuard.trackRequest();
+
+        tracer.start(stream.trace);
+        stream.trace.mark(TracePhase::REQUEST_RECEIVED);
+
+        Request request = getRequest(stream.getRequestFields());
+
+        stream.trace.mark(TracePhase::REQUEST_PARSED);
+        stream.trace.setResource(request.file);
+
+        co_await performRequest(stream, request);
+
+        tracer.finish(stream.trace);
+
+        std::cout << "Finished performing request." << std::endl;
     }
 
-    HTTPServer::Request HTTPServer::getRequest() {
-        std::optional<std::string> requestLine = lineReader.readLine();
+    Task<HTTPServer::Request> HTTPServer::getRequest(Connection &connection) {
+        std::optional<std::string> requestLine = co_await connection.lineReader.readLine();
 
         if (!requestLine) {
-            return WrongRequest;
+            co_return WrongRequest;
         }
 
+        /* Clients with prior knowledge of HTTP/2 start with the connection preface, which resembles a request. */
+        if (HTTP2Connection::CLIENT_PREFACE.starts_with(requestLine.value())) {
+            std::string preface = std::move(requestLine.value());
+
+            while (preface.size() < HTTP2Connection::CLIENT_PREFACE.size()) {
+                std::optional<std::string> prefaceLine = co_await connection.lineReader.readLine();
+
+                if (!prefaceLine) {
+                    co_return WrongRequest;
+                }
+
+                preface += prefaceLine.value();
+            }
+
+            co_return preface == HTTP2Connection::CLIENT_PREFACE ? HTTP2PrefaceRequest : WrongRequest;
+        }
+
+        tracer.start(connection.trace);
+
+        /* Time between accepting the connection and its first request is attributed to that request. */
+        if (connection.acceptedAt != 0) {
+            connection.trace.markAt(TracePhase::ACCEPTED, std::exchange(connection.acceptedAt, 0));
+        }
+
+        connection.trace.mark(TracePhase::REQUEST_RECEIVED);
+
         std::regex requestLineRegex{R"(([^ ]+) (\/.*) ([^ ]+)\r\n)"};
 
         std::smatch matches;
         if (!std::regex_match(requestLine.value(), matches, requestLineRegex)) {
-            return WrongRequest;
+            co_return WrongRequest;
         }
 
         std::string method = matches.str(1);
@@ -106,12 +383,13 @@ namespace SIK {
 
         std::string connectionFieldValue;
         std::string contentLengthFieldValue;
+        std::string acceptEncodingFieldValue;
 
         while (true) {
-            std::optional<std::string> headerField = lineReader.readLine();
+            std::optional<std::string> headerField = co_await connection.lineReader.readLine();
 
             if (!headerField) {
-                return WrongRequest;
+                co_return WrongRequest;
             }
 
             std::string headerFieldString = headerField.value();
@@ -123,7 +401,7 @@ namespace SIK {
             auto colonPosition = headerFieldString.find(':');
 
             if (colonPosition == std::string::npos) {
-                return WrongRequest;
+                co_return WrongRequest;
             }
 
             std::string fieldName = headerFieldString.substr(0, colonPosition);
@@ -135,65 +413,206 @@ namespace SIK {
 
             if (fieldName == "connection") {
                 if (!connectionFieldValue.empty()) {
-                    return WrongRequest;
+                    co_return WrongRequest;
                 }
 
                 connectionFieldValue = std::move(fieldValue);
             } else if (fieldName == "content-length") {
                 if (!contentLengthFieldValue.empty()) {
-                    return WrongRequest;
+                    co_return WrongRequest;
                 }
 
                 contentLengthFieldValue = std::move(fieldValue);
+            } else if (fieldName == "accept-encoding") {
+                /* Multiple fields are equivalent to a single one with comma-separated values. */
+                acceptEncodingFieldValue += "," + fieldValue;
             }
         }
 
         if (httpVersionOfRequest != "HTTP/1.1") {
-            return WrongRequest;
+            co_return WrongRequest;
         }
 
         if (method != "GET" && method != "HEAD") {
-            return NotImplementedRequest;
+            co_return NotImplementedRequest;
         }
 
         if (!contentLengthFieldValue.empty() && contentLengthFieldValue != "0") {
-            return WrongRequest;
+            co_return WrongRequest;
         }
 
         if (!connectionFieldValue.empty() && connectionFieldValue != "close" &&
             connectionFieldValue != "keep-alive") {
+            co_return NotImplementedRequest;
+        }
+
+        co_return Request{RequestState::OK, method == "GET" ? RequestKind::GET : RequestKind::HEAD,
+                          std::move(requestTarget), connectionFieldValue != "close",
+                          isGzipAccepted(acceptEncodingFieldValue)};
+    }
+
+    HTTPServer::Request HTTPServer::getRequest(const std::vector<HeaderField> &fields) {
+        std::string method;
+        std::string path;
+        std::string acceptEncodingFieldValue;
+
+        for (const auto &[name, value] : fields) {
+            if (name == ":method") {
+                method = value;
+            } else if (name == ":path") {
+                path = value;
+            } else if (name == "accept-encoding") {
+                acceptEncodingFieldValue += "," + value;
+            }
+        }
+
+        if (method.empty() || !path.starts_with('/')) {
+            return WrongRequest;
+        }
+
+        if (method != "GET" && method != "HEAD") {
             return NotImplementedRequest;
         }
 
-        return {RequestState::OK, method == "GET" ? RequestKind::GET : RequestKind::HEAD,
-                std::move(requestTarget), connectionFieldValue != "close"};
+        /* Streams end with their responses, the connection stays open anyway. */
+        return Request{RequestState::OK, method == "GET" ? RequestKind::GET : RequestKind::HEAD,
+                       std::move(path), true, isGzipAccepted(acceptEncodingFieldValue)};
     }
 
-    bool HTTPServer::performRequest(const Request &request) {
+    Task<bool> HTTPServer::performRequest(ResponseSink &response, const Request &request) {
+        response.responseStarted = false;
+
         if (request.state == RequestState::OK) {
+            bool fileSent = false;
+            std::exception_ptr failure;
+
             try { // Trying to send file.
-                auto filePath = relativeResourcePathToAbsolute(request.file);
+                if (bundle) {
+                    fileSent = co_await sendFromBundle(response, request);
+                } else if (fileCache) {
+                    fileSent = co_await sendFromCache(response, request);
+                } else {
+                    auto filePath = relativeResourcePathToAbsolute(request.file);
+                    response.trace.mark(TracePhase::RESOURCE_RESOLVED);
+
+                    co_await sendOK(response, fs::file_size(filePath.value()));
+                    if (request.kind == RequestKind::GET) {
+                        co_await response.sendFile(filePath.value());
+                        response.trace.mark(TracePhase::BODY_SENT);
+                    }
 
-                sendOK(filePath.value());
-                if (request.kind == RequestKind::GET) {
-                    client->sendFile(filePath.value());
+                    fileSent = true;
                 }
             } catch (const std::exception &e) {
+                failure = std::current_exception();
+            }
+
+            /* Client has already got a part of the response, it has to learn that the response is
+             * incomplete: HTTP/1.1 connection gets closed, HTTP/2 stream gets reset. */
+            if (failure && response.responseStarted) {
+                std::rethrow_exception(failure);
+            }
+
+            /* Responses cannot be sent from inside of the catch block, as it may not contain co_await. */
+            if (!fileSent) {
                 auto httpAddress = correlatedServers.getResourceHTTPAddress(request.file);
 
                 if (httpAddress) {
-                    sendFound(httpAddress.value());
+                    co_await sendFound(response, httpAddress.value());
                 } else {
-                    sendNotFound();
+                    co_await sendNotFound(response);
                 }
             }
         } else if (request.state == RequestState::WRONG_FORMAT) {
-            sendBadRequest();
+            co_await sendBadRequest(response);
         } else if (request.state == RequestState::NOT_IMPLEMENTED) {
-            sendNotImplemented();
+            co_await sendNotImplemented(response);
+        }
+
+        co_return request.keepAlive;
+    }
+
+    Task<bool> HTTPServer::sendFromBundle(ResponseSink &response, const Request &request) {
+        /* Normalizing an absolute path lexically never leads above the root. */
+        const ContentBundle::Entry *entry = bundle->find(fs::path{request.file}.lexically_normal().generic_string());
+        response.trace.mark(TracePhase::RESOURCE_RESOLVED);
+
+        if (entry == nullptr) {
+            co_return false;
+        }
+
+        bool hasGzipVariant = entry->gzipBodySize > 0;
+        bool gzipEncoded = hasGzipVariant && request.acceptsGzip;
+
+        auto bodyOffset = gzipEncoded ? entry->gzipBodyOffset : entry->bodyOffset;
+        auto bodySize = gzipEncoded ? entry->gzipBodySize : entry->bodySize;
+
+        /* Both variants come from the same file, yet a strong entity tag has to tell them apart. */
+        std::ostringstream entityTag;
+        entityTag << '"' << std::hex << std::setw(16) << std::setfill('0') << entry->contentHash
+                  << (gzipEncoded ? "-gzip" : "") << '"';
+
+        std::vector<HeaderField> validatorFields{{"ETag", entityTag.str()},
+                                                 {"Last-Modified", formatHTTPDate(entry->modificationTime)}};
+
+        co_await sendOK(response, bodySize, hasGzipVariant, gzipEncoded, std::move(validatorFields));
+        if (request.kind == RequestKind::GET) {
+            co_await response.sendFileRange(bundle->getDescriptor(), bodyOffset, bodySize);
+            response.trace.mark(TracePhase::BODY_SENT);
+        }
+
+        co_return true;
+    }
+
+    Task<bool> HTTPServer::sendFromCache(ResponseSink &response, const Request &request) {
+        /* Aliases like /./a.txt share the entry, so that they neither take up the cache nor split the hit counts. */
+        std::string resource = fs::path{request.file}.lexically_normal().generic_string();
+
+        const FileCache::File *file = fileCache->find(resource);
+
+        if (file == nullptr) {
+            auto filePath = relativeResourcePathToAbsolute(resource);
+
+            if (!filePath) {
+                co_return false;
+            }
+
+            file = fileCache->add(resource, filePath.value());
+
+            if (file == nullptr) {
+                co_return false;
+            }
+        }
+
+        response.trace.mark(TracePhase::RESOURCE_RESOLVED);
+
+        /* Cache entry may be gone once the coroutine is suspended, the open file stays. */
+        auto openFile = file->openFile;
+        auto fileSize = file->size;
+
+        co_await sendOK(response, fileSize);
+        if (request.kind == RequestKind::GET) {
+            co_await response.sendFileRange(openFile->descriptor, 0, fileSize);
+            response.trace.mark(TracePhase::BODY_SENT);
+        }
+
+        co_return true;
+    }
+
+    Task<void> HTTPServer::saveAccessManifest() {
+        while (true) {
+            co_await scheduler.sleep(ACCESS_MANIFEST_SAVE_INTERVAL);
+
+            fileCache->saveManifest();
         }
+    }
+
+    Task<void> HTTPServer::exportRequestTraces() {
+        while (true) {
+            co_await scheduler.sleep(TRACE_EXPORT_INTERVAL);
 
-        return request.keepAlive;
+            tracer.exportChromeTrace();
+        }
     }
 
     std::optional<fs::path> HTTPServer::relativeResourcePathToAbsolute(const fs::path &relativeFilePath) {
@@ -207,12 +626,7 @@ namespace SIK {
             return std::nullopt;
         }
 
-        /* Iterator rootEnd points to the first mismatch between rootDirectory and filePath.
-         * If rootEnd != rootDirectory.end() then it means that client has tried to reach
-         * above rootDirectory. */
-        auto rootEnd = std::mismatch(rootDirectory.begin(), rootDirectory.end(), filePath.begin()).first;
-
-        if (rootEnd != rootDirectory.end()) {
+        if (!isWithin(rootDirectory, filePath)) {
             std::cout << "Trying to reach above root server directory!" << std::endl;
             return std::nullopt;
         }
@@ -220,12 +634,16 @@ namespace SIK {
         return filePath;
     }
 
-    std::optional<std::string> HTTPServer::CRLFLineReader::readLine() {
+    Task<std::optional<std::string>> HTTPServer::CRLFLineReader::readLine() {
         std::string line;
 
         while (line.size() < 2 || line.back() != '\n' || line[line.size() - 2] != '\r') {
             if (begin == end) {
-                ssize_t bytesRead = serverRef.client->readData(buffer, BUFFER_SIZE);
+                ssize_t bytesRead = co_await client.readData(buffer, BUFFER_SIZE);
+
+                if (bytesRead == 0) {
+                    throw ClientDisconnectedException{};
+                }
 
                 begin = buffer;
                 end = buffer + bytesRead;
@@ -234,87 +652,106 @@ namespace SIK {
             line.push_back(*begin++);
 
             if (line.length() > BUFFER_SIZE) {
-                return std::nullopt;
+                co_return std::nullopt;
             }
         }
 
-        return line;
+        co_return line;
     }
 
-    void HTTPServer::sendOK(const fs::path &filePath) {
+    Task<void> HTTPServer::Connection::sendHead(unsigned status, const char *reason,
+                                                const std::vector<HeaderField> &fields) {
         std::ostringstream stream;
 
-        stream << httpVersionOfServer << " 200 OK\r\n"
-               << "Content-Type: application/octet-stream\r\n"
-               << "Content-Length: " << fs::file_size(filePath) << "\r\n"
-               << "Server: " << serverName << "\r\n"
-               << "\r\n";
+        stream << httpVersionOfServer << " " << status << " " << reason << "\r\n";
 
-        client->sendText(stream.str());
+        bool closeAnnounced = false;
 
-        std::cout << "200 OK sent." << std::endl;
+        for (const auto &[name, value] : fields) {
+            stream << name << ": " << value << "\r\n";
+            closeAnnounced |= name == "Connection";
+        }
+
+        /* Otherwise the client could send the next request over the connection being closed. */
+        if (closing && !closeAnnounced) {
+            stream << "Connection: close\r\n";
+        }
+
+        stream << "\r\n";
+
+        co_await client->sendText(stream.str());
     }
 
-    void HTTPServer::sendFound(const std::string &httpAddress) {
-        std::ostringstream stream;
+    Task<void> HTTPServer::sendOK(ResponseSink &response, uintmax_t contentLength, bool negotiated,
+                                  bool gzipEncoded, std::vector<HeaderField> validatorFields) {
+        std::vector<HeaderField> fields{{"Content-Type", "application/octet-stream"},
+                                        {"Content-Length", std::to_string(contentLength)}};
 
-        stream << httpVersionOfServer << " 302 Found\r\n"
-               << "Location: " << httpAddress << "\r\n"
-               << "Server: " << serverName << "\r\n"
-               << "\r\n";
+        if (gzipEncoded) {
+            fields.push_back({"Content-Encoding", "gzip"});
+        }
 
-        client->sendText(stream.str());
+        if (negotiated) {
+            fields.push_back({"Vary", "Accept-Encoding"});
+        }
 
-        std::cout << "302 Found sent." << std::endl;
+        fields.insert(fields.end(), validatorFields.begin(), validatorFields.end());
+
+        fields.push_back({"Server", serverName});
+
+        response.responseStarted = true;
+
+        co_await response.sendHead(200, "OK", fields);
+        response.trace.markHeadSent(200);
+
+        std::cout << "200 OK sent." << std::endl;
     }
 
-    void HTTPServer::sendBadRequest() {
-        std::ostringstream stream;
+    Task<void> HTTPServer::sendFound(ResponseSink &response, const std::string &httpAddress) {
+        std::vector<HeaderField> fields{{"Location", httpAddress},
+                                        {"Server", serverName}};
+
+        co_await response.sendHead(302, "Found", fields);
+        response.trace.markHeadSent(302);
+
+        std::cout << "302 Found sent." << std::endl;
+    }
 
-        stream << httpVersionOfServer << " 400 Bad Request\r\n"
-               << "Connection: close\r\n"
-               << "Server: " << serverName << "\r\n"
-               << "\r\n";
+    Task<void> HTTPServer::sendBadRequest(ResponseSink &response) {
+        std::vector<HeaderField> fields{{"Connection", "close"},
+                                        {"Server", serverName}};
 
-        client->sendText(stream.str());
+        co_await response.sendHead(400, "Bad Request", fields);
+        response.trace.markHeadSent(400);
 
         std::cout << "400 Bad Request sent." << std::endl;
     }
 
-    void HTTPServer::sendNotFound() {
-        std::ostringstream stream;
-
-        stream << httpVersionOfServer << " 404 Not Found\r\n"
-               << "Server: " << serverName << "\r\n"
-               << "\r\n";
+    Task<void> HTTPServer::sendNotFound(ResponseSink &response) {
+        std::vector<HeaderField> fields{{"Server", serverName}};
 
-        client->sendText(stream.str());
+        co_await response.sendHead(404, "Not Found", fields);
+        response.trace.markHeadSent(404);
 
         std::cout << "404 Not Found sent." << std::endl;
     }
 
-    void HTTPServer::sendInternalServerError() {
-        std::ostringstream stream;
-
-        stream << httpVersionOfServer << " 500 Bad Internal Server Error\r\n"
-               << "Connection: close\r\n"
-               << "Server: " << serverName << "\r\n"
-               << "\r\n";
+    Task<void> HTTPServer::sendInternalServerError(ResponseSink &response) {
+        std::vector<HeaderField> fields{{"Connection", "close"},
+                                        {"Server", serverName}};
 
-        client->sendText(stream.str());
+        co_await response.sendHead(500, "Bad Internal Server Error", fields);
+        response.trace.markHeadSent(500);
 
         std::cout << "500 Internal Server Error sent." << std::endl;
     }
 
-    void HTTPServer::sendNotImplemented() {
-        std::ostringstream stream;
-
-        stream << httpVersionOfServer << " 501 Not Implemented\r\n"
-               << "Server: " << serverName << "\r\n"
-               << "\r\n";
+    Task<void> HTTPServer::sendNotImplemented(ResponseSink &response) {
+        std::vector<HeaderField> fields{{"Server", serverName}};
 
-        client->sendText(stream.str());
+        co_await response.sendHead(501, "Not Implemented", fields);
+        response.trace.markHeadSent(501);
 
         std::cout << "501 Not Implemented sent." << std::endl;
     }
-}
\ No newline at end of file
+}
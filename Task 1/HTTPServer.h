@@ -2,8 +2,11 @@
 #define SIKZAD1_HTTPSERVER_H
 
 #include <string>
+#include <ctime>
 #include <filesystem>
+#include <iomanip>
 #include <iostream>
+#include <unordered_set>
 #include <utility>
 
 #include <fcntl.h>
@@ -11,7 +14,16 @@
 #include <sys/stat.h>
 
 #include "Auxiliary.h"
+#include "ContentBundle.h"
 #include "CorrelatedServers.h"
+#include "FileCache.h"
+#include "HTTP2Connection.h"
+#include "ListenerHandoff.h"
+#include "OverloadGuard.h"
+#include "RequestTracer.h"
+#include "ResponseSink.h"
+#include "Scheduler.h"
+#include "Task.h"
 #include "TCPSocket.h"
 
 namespace SIK {
@@ -31,14 +43,48 @@ namespace SIK {
         }
     };
 
-    /* Class managing HTTP 1.1 server. */
+    /* Configuration of optional server features. */
+    struct ServerOptions {
+        /* Tuning of the listening socket and client sockets. */
+        SocketOptions socketOptions;
+
+        /* Thresholds of the load shedding. */
+        OverloadLimits overloadLimits;
+
+        /* Path of Unix socket through which listening socket is passed on restart. Empty disables restarts. */
+        std::string handoffSocketPath;
+
+        /* Time given to open connections to finish after the listening socket is handed over. */
+        std::chrono::seconds drainTimeout{30};
+
+        /* Time after which connections awaiting a request are closed. Zero disables the timeout. */
+        std::chrono::seconds idleTimeout{60};
+
+        /* Maximum number of files kept open in the file cache. Zero disables the cache,
+         * unless warm-up is requested. */
+        size_t fileCacheCapacity = 0;
+
+        /* Way of warming up the file cache on startup. */
+        WarmUpMode warmUpMode = WarmUpMode::NONE;
+
+        /* Path of file in which the file cache saves how often files are requested. */
+        std::string accessManifestPath;
+
+        /* Sampling, slow request dumps and export of request traces. */
+        TraceOptions traceOptions;
+    };
+
+    /* Class managing HTTP 1.1 server, which also speaks HTTP/2 with clients having prior knowledge
+     * of it. Every client connection and every HTTP/2 stream is served by its own coroutine,
+     * all of them driven by a single event loop. */
     class HTTPServer {
     public:
         /* Creates new HTTP server, loads correlated servers
          * and starts listening for client connections. */
         HTTPServer(const std::string &filesFolderName,
                    const std::string &correlatedServersFileName,
-                   uint16_t portNumber);
+                   uint16_t portNumber,
+                   const ServerOptions &options = {});
 
         /* Copy and move semantics are disabled due to the nature of connection. */
         HTTPServer(const HTTPServer &) = delete;
@@ -46,13 +92,16 @@ namespace SIK {
         HTTPServer &operator=(const HTTPServer &) = delete;
 
         /* Starts up server. */
-        void start();
+        [[noreturn]] void start();
 
     private:
         enum class RequestState {
             OK,
             WRONG_FORMAT,
-            NOT_IMPLEMENTED
+            NOT_IMPLEMENTED,
+
+            /* Client has sent HTTP/2 connection preface instead of a request. */
+            HTTP2_PREFACE
         };
 
         enum class RequestKind {
@@ -66,85 +115,221 @@ namespace SIK {
             RequestKind kind;
             std::string file;
             bool keepAlive;
+            bool acceptsGzip;
         };
 
         inline static const Request WrongRequest = {RequestState::WRONG_FORMAT,
-                                                    RequestKind::NA, "", false};
+                                                    RequestKind::NA, "", false, false};
 
         inline static const Request NotImplementedRequest = {RequestState::NOT_IMPLEMENTED,
-                                                             RequestKind::NA, "", true};
+                                                             RequestKind::NA, "", true, false};
+
+        inline static const Request HTTP2PrefaceRequest = {RequestState::HTTP2_PREFACE,
+                                                           RequestKind::NA, "", true, false};
+
+        /* Class managing buffer for reading CRLF-ended (carriage return, line feed) lines from the client. */
+        class CRLFLineReader {
+        public:
+            explicit CRLFLineReader(const TCPSocket::ClientConnection &client) : buffer{}, begin{}, end{},
+                                                                                 client(client) {}
+
+            /* Fetches CRLF-ended from the client. */
+            Task<std::optional<std::string>> readLine();
+
+            /* Returns true if some data read from the client has not been consumed yet. */
+            [[nodiscard]] bool hasBufferedData() const {
+                return begin != end;
+            }
+
+            /* Returns data read from the client which has not been consumed yet, consuming it. */
+            std::string_view takeBufferedData() {
+                return {std::exchange(begin, end), end};
+            }
+
+        private:
+            /* Size of the buffer. */
+            static constexpr size_t BUFFER_SIZE = 16384;
+
+            /* Buffer for storing read CRLF line. */
+            char buffer[BUFFER_SIZE];
+
+            /* Begin and end of currently read CRLF line. */
+            const char *begin;
+            const char *end;
+
+            /* Client from which lines are read. */
+            const TCPSocket::ClientConnection &client;
+        };
+
+        /* State of a single connection with a client. Responses to HTTP/1.1 requests are written straight to it. */
+        struct Connection final : ResponseSink {
+            explicit Connection(std::unique_ptr<TCPSocket::ClientConnection> clientConnection)
+                    : client{std::move(clientConnection)}, lineReader{*client} {}
+
+            Task<void> sendHead(unsigned status, const char *reason, const std::vector<HeaderField> &fields) override;
+
+            Task<void> sendFileRange(int fileDescriptor, off64_t offset, size_t count) override {
+                return client->sendFileRange(fileDescriptor, offset, count);
+            }
+
+            Task<void> sendFile(const std::filesystem::path &filePath) override {
+                return client->sendFile(filePath);
+            }
+
+            /* Client being served. */
+            std::unique_ptr<TCPSocket::ClientConnection> client;
+
+            /* Object for reading CRLF-ended lines from client. */
+            CRLFLineReader lineReader;
+
+            /* True while awaiting the next request. */
+            bool idle = false;
+
+            /* Moment since which the connection has been awaiting the next request. */
+            std::chrono::steady_clock::time_point idleSince;
+
+            /* HTTP/2 connection, once the client has switched to HTTP/2. */
+            HTTP2Connection *http2Connection = nullptr;
+
+            /* True once the connection is going to end after the current response, which then tells the client so. */
+            bool closing = false;
+
+            /* Moment the connection has been accepted, if tracing is enabled and its first request has not come yet. */
+            uint64_t acceptedAt = 0;
+        };
+
+        /* Accepts client connections and spawns coroutine serving each of them. */
+        Task<void> acceptClients();
+
+        /* Hands listening socket over to the new process on restart, then drains connections and exits. */
+        Task<void> handleRestart();
+
+        /* Closes connections which have been awaiting a request for longer than the idle timeout,
+         * HTTP/2 ones once they have had no open streams for that long. */
+        Task<void> closeIdleConnections();
+
+        /* Serves requests of the client until the connection ends. */
+        Task<void> serveClient(std::unique_ptr<TCPSocket::ClientConnection> clientConnection,
+                               OverloadGuard::Tracker connectionTracker);
+
+        /* Serves HTTP/2 streams of the client, once it has sent the connection preface. */
+        Task<void> serveMultiplexed(Connection &connection);
+
+        /* Serves request sent on HTTP/2 stream. */
+        Task<void> serveStream(HTTP2Stream &stream);
 
         /* Fetches request from the client. */
-        Request getRequest();
+        Task<Request> getRequest(Connection &connection);
+
+        /* Builds request from header fields of HTTP/2 stream. */
+        static Request getRequest(const std::vector<HeaderField> &fields);
 
         /* Performs client's request. Returns true if the connection is to be kept alive.
          * Returns false otherwise. */
-        bool performRequest(const Request &request);
+        Task<bool> performRequest(ResponseSink &response, const Request &request);
+
+        /* Sends the resource from the bundle. Returns false if the bundle does not contain it. */
+        Task<bool> sendFromBundle(ResponseSink &response, const Request &request);
+
+        /* Sends the resource using the file cache. Returns false if there is no such file. */
+        Task<bool> sendFromCache(ResponseSink &response, const Request &request);
+
+        /* Saves the access manifest of the file cache from time to time. */
+        Task<void> saveAccessManifest();
+
+        /* Exports request traces from time to time. */
+        Task<void> exportRequestTraces();
 
         /* Returns absolute path to the resource. */
         std::optional<std::filesystem::path>
         relativeResourcePathToAbsolute(const std::filesystem::path &relativeFilePath);
 
-        /* Sends 200 OK to the client. */
-        void sendOK(const std::filesystem::path &filePath);
+        /* Sends 200 OK to the client. If the body has been chosen according to Accept-Encoding,
+         * negotiated is true, and gzipEncoded tells whether the gzip variant has been chosen.
+         * Validator fields of the body, if known, are sent as well. */
+        Task<void> sendOK(ResponseSink &response, uintmax_t contentLength, bool negotiated = false,
+                          bool gzipEncoded = false, std::vector<HeaderField> validatorFields = {});
 
         /* Sends 302 Found to the client. */
-        void sendFound(const std::string &httpAddress);
+        Task<void> sendFound(ResponseSink &response, const std::string &httpAddress);
 
         /* Sends 400 Bad Request to the client. */
-        void sendBadRequest();
+        Task<void> sendBadRequest(ResponseSink &response);
 
         /* Sends 404 Not Found to the client. */
-        void sendNotFound();
+        Task<void> sendNotFound(ResponseSink &response);
 
         /* Sends 500 Internal Server Error to the client. */
-        void sendInternalServerError();
+        Task<void> sendInternalServerError(ResponseSink &response);
 
         /* Sends 501 Not Implemented to the client. */
-        void sendNotImplemented();
+        Task<void> sendNotImplemented(ResponseSink &response);
 
-        friend class CRLFLineReader;
-
-        /* Class managing buffer for reading CRLF-ended (carriage return, line feed) lines from the client. */
-        class CRLFLineReader {
-        public:
-            explicit CRLFLineReader(HTTPServer &serverRef) : buffer{}, begin{}, end{}, serverRef(serverRef) {}
+        static constexpr const char *httpVersionOfServer = "HTTP/1.1";
+        static constexpr const char *serverName = "NaimadServer";
 
-            /* Fetches CRLF-ended from the client. */
-            std::optional<std::string> readLine();
+        /* How often draining server checks whether all connections have ended. */
+        static constexpr std::chrono::milliseconds DRAIN_CHECK_INTERVAL{100};
 
-        private:
-            /* Size of the buffer. */
-            static constexpr size_t BUFFER_SIZE = 16384;
+        /* How long accepting is paused when the process runs out of descriptors. */
+        static constexpr std::chrono::milliseconds ACCEPT_RETRY_DELAY{100};
 
-            /* Buffer for storing read CRLF line. */
-            char buffer[BUFFER_SIZE];
+        /* How often connections are checked for exceeding the idle timeout. */
+        static constexpr std::chrono::milliseconds IDLE_CHECK_INTERVAL{1000};
 
-            /* Begin and end of currently read CRLF line. */
-            const char *begin;
-            const char *end;
+        /* Capacity of the file cache, if it is enabled only by warm-up. */
+        static constexpr size_t DEFAULT_FILE_CACHE_CAPACITY = 4096;
 
-            /* Reference to containing HTTP server. */
-            HTTPServer &serverRef;
-        };
+        /* How often the access manifest is saved. */
+        static constexpr std::chrono::milliseconds ACCESS_MANIFEST_SAVE_INTERVAL{60000};
 
-        static constexpr const char *httpVersionOfServer = "HTTP/1.1";
-        static constexpr const char *serverName = "NaimadServer";
+        /* How often request traces are exported. */
+        static constexpr std::chrono::milliseconds TRACE_EXPORT_INTERVAL{10000};
 
         /* Object containing HTTP addresses of relocated resources. */
         CorrelatedServers correlatedServers;
 
+        /* Event loop driving coroutines serving clients. */
+        Scheduler scheduler;
+
+        /* Listening socket taken over from the previous process, if any. */
+        ListenerTakeover takeover;
+
         /* TCP socket through which HTTP server communicates. */
         TCPSocket socket;
 
+        /* Object deciding whether new clients should be rejected. */
+        OverloadGuard overloadGuard;
+
         /* Directory from which server fetches files to send to the client. */
         std::filesystem::path rootDirectory;
 
-        /* Pointer to the client being currently served. */
-        TCPSocket::ClientConnection *client;
+        /* Bundle from which server fetches files instead of the directory, if one was given. */
+        std::optional<ContentBundle> bundle;
+
+        /* Cache of files from the root directory, if enabled. */
+        std::optional<FileCache> fileCache;
+
+        /* Way of warming up the file cache on startup. */
+        WarmUpMode warmUpMode;
+
+        /* Handoff socket through which the next process takes over on restart. */
+        std::optional<ListenerHandoff> handoff;
+
+        /* Time given to open connections to finish on restart. */
+        std::chrono::seconds drainTimeout;
+
+        /* Time after which connections awaiting a request are closed. */
+        std::chrono::seconds idleTimeout;
+
+        /* Object recording phases of sampled requests. */
+        RequestTracer tracer;
+
+        /* All open connections with clients. */
+        std::unordered_set<Connection *> connections;
 
-        /* Object for reading CRLF-ended lines from client. */
-        CRLFLineReader lineReader;
+        /* True if the server no longer accepts clients and finishes serving the connected ones. */
+        bool draining = false;
     };
 }
 
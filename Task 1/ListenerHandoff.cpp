@@ -0,0 +1,210 @@
+#include "ListenerHandoff.h"
+
+#include <cstring>
+
+namespace {
+    /* Byte sent by the new process to confirm the takeover. */
+    constexpr char TAKEOVER_CONFIRMATION = 'R';
+
+    /* How long the new process waits for the listening socket. */
+    constexpr timeval TAKEOVER_TIMEOUT = {5, 0};
+
+    /* Returns address of Unix socket at given path. */
+    sockaddr_un unixSocketAddress(const std::string &path) {
+        sockaddr_un address{};
+
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw SIK::HandoffSocketException{};
+        }
+
+        address.sun_family = AF_UNIX;
+        strcpy(address.sun_path, path.c_str());
+
+        return address;
+    }
+}
+
+namespace SIK {
+    ListenerTakeover::ListenerTakeover(const std::string &handoffSocketPath) {
+        if (handoffSocketPath.empty()) {
+            return;
+        }
+
+        sockaddr_un address = unixSocketAddress(handoffSocketPath);
+
+        int descriptor = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        if (descriptor < 0) {
+            throw HandoffSocketException{};
+        }
+
+        if (connect(descriptor, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+            int connectError = errno;
+            close(descriptor);
+
+            /* Nobody to take over from - this is the first process. */
+            if (connectError == ENOENT || connectError == ECONNREFUSED) {
+                return;
+            }
+
+            throw HandoffSocketException{};
+        }
+
+        setsockopt(descriptor, SOL_SOCKET, SO_RCVTIMEO, &TAKEOVER_TIMEOUT, sizeof(TAKEOVER_TIMEOUT));
+
+        char byte;
+        iovec data = {&byte, 1};
+
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+
+        msghdr message{};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t bytesRead;
+
+        do {
+            bytesRead = recvmsg(descriptor, &message, MSG_CMSG_CLOEXEC);
+        } while (bytesRead < 0 && errno == EINTR);
+
+        cmsghdr *header = CMSG_FIRSTHDR(&message);
+
+        if (bytesRead != 1 || header == nullptr || header->cmsg_level != SOL_SOCKET ||
+            header->cmsg_type != SCM_RIGHTS) {
+            close(descriptor);
+            throw HandoffTransferException{};
+        }
+
+        int listener;
+        memcpy(&listener, CMSG_DATA(header), sizeof(listener));
+
+        controlDescriptor = descriptor;
+        takenDescriptor = listener;
+    }
+
+    void ListenerTakeover::confirm() {
+        if (controlDescriptor < 0) {
+            return;
+        }
+
+        /* If the confirmation does not get through, both processes keep accepting
+         * clients from the shared listen queue, which is harmless. */
+        if (write(controlDescriptor, &TAKEOVER_CONFIRMATION, 1) != 1) {
+            std::cout << "Confirming listener takeover failed!" << std::endl;
+        }
+
+        close(controlDescriptor);
+        controlDescriptor = -1;
+    }
+
+    ListenerHandoff::ListenerHandoff(const std::string &handoffSocketPath, Scheduler &scheduler)
+            : handoffSocketPath{handoffSocketPath},
+              temporaryPath{handoffSocketPath + "." + std::to_string(getpid())}, scheduler{scheduler} {
+        sockaddr_un address = unixSocketAddress(temporaryPath);
+
+        handoffDescriptor = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+        if (handoffDescriptor < 0) {
+            throw HandoffSocketException{};
+        }
+
+        /* Path may be left by a process which had the same identifier and was killed. */
+        unlink(temporaryPath.c_str());
+
+        if (bind(handoffDescriptor, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+            listen(handoffDescriptor, 1) < 0) {
+            close(handoffDescriptor);
+            unlink(temporaryPath.c_str());
+            throw HandoffSocketException{};
+        }
+    }
+
+    void ListenerHandoff::publish() {
+        /* Renaming replaces the socket of the previous process atomically, so the path always leads somewhere. */
+        if (rename(temporaryPath.c_str(), handoffSocketPath.c_str()) < 0) {
+            std::cout << "Publishing listener handoff socket failed!" << std::endl;
+            return;
+        }
+
+        published = true;
+    }
+
+    Task<void> ListenerHandoff::handOver(int listenerDescriptor) {
+        while (true) {
+            errno = 0;
+            int controlDescriptor = accept4(handoffDescriptor, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+            if (controlDescriptor < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    co_await scheduler.readable(handoffDescriptor);
+                } else if (errno != EINTR) {
+                    throw HandoffSocketException{};
+                }
+
+                continue;
+            }
+
+            std::cout << "New process is taking over listening socket." << std::endl;
+
+            bool confirmed = false;
+
+            try {
+                confirmed = co_await handOverTo(controlDescriptor, listenerDescriptor);
+            } catch (const std::exception &e) {
+                std::cout << e.what() << std::endl;
+            }
+
+            scheduler.forget(controlDescriptor);
+            close(controlDescriptor);
+
+            if (confirmed) {
+                co_return;
+            }
+
+            std::cout << "New process has not taken over listening socket, still serving clients." << std::endl;
+        }
+    }
+
+    Task<bool> ListenerHandoff::handOverTo(int controlDescriptor, int listenerDescriptor) {
+        char byte = 0;
+        iovec data = {&byte, 1};
+
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+
+        msghdr message{};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        cmsghdr *header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(header), &listenerDescriptor, sizeof(listenerDescriptor));
+
+        while (sendmsg(controlDescriptor, &message, MSG_NOSIGNAL) != 1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                co_await scheduler.writable(controlDescriptor);
+            } else if (errno != EINTR) {
+                throw HandoffTransferException{};
+            }
+        }
+
+        while (true) {
+            ssize_t bytesRead = read(controlDescriptor, &byte, 1);
+
+            if (bytesRead >= 0) {
+                co_return bytesRead == 1 && byte == TAKEOVER_CONFIRMATION;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                co_await scheduler.readable(controlDescriptor);
+            } else if (errno != EINTR) {
+                co_return false;
+            }
+        }
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef SIKZAD1_LISTENERHANDOFF_H
+#define SIKZAD1_LISTENERHANDOFF_H
+
+#include <optional>
+#include <string>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "Auxiliary.h"
+#include "Scheduler.h"
+#include "Task.h"
+
+namespace SIK {
+    class HandoffSocketException : public ServerException {
+    public:
+        [[nodiscard]] const char *what() const noexcept override {
+            return "Creating listener handoff socket failed!";
+        }
+    };
+
+    class HandoffTransferException : public ServerException {
+    public:
+        [[nodiscard]] const char *what() const noexcept override {
+            return "Passing listening socket to another process failed!";
+        }
+    };
+
+    /* Restart works as follows: the new process connects to the handoff socket of the old one
+     * and receives its listening socket. Once the new process is ready to serve clients it
+     * confirms it, and the old process stops accepting, drains its connections and exits.
+     * Listen queue is shared by both processes, so no client is refused in the meantime.
+     * Only then the new process moves its own handoff socket to the path, so that a new
+     * process failing before the confirmation leaves the old one reachable for the next. */
+
+    /* New process' side of the restart. */
+    class ListenerTakeover {
+    public:
+        /* Takes over listening socket from the process serving handoff socket at given path.
+         * If the path is empty or no process serves it, nothing is taken over. */
+        explicit ListenerTakeover(const std::string &handoffSocketPath);
+
+        /* Closes connection with the old process. If the takeover has not been
+         * confirmed, the old process keeps serving clients. */
+        ~ListenerTakeover() {
+            if (controlDescriptor >= 0) {
+                close(controlDescriptor);
+            }
+        }
+
+        ListenerTakeover(const ListenerTakeover &) = delete;
+
+        ListenerTakeover &operator=(const ListenerTakeover &) = delete;
+
+        /* Returns listening socket taken over from the old process. */
+        [[nodiscard]] std::optional<int> listenerDescriptor() const {
+            return takenDescriptor;
+        }
+
+        /* Tells the old process that it may stop accepting clients. */
+        void confirm();
+
+    private:
+        /* Connection with the old process. */
+        int controlDescriptor = -1;
+
+        /* Listening socket received from the old process. */
+        std::optional<int> takenDescriptor;
+    };
+
+    /* Old process' side of the restart. */
+    class ListenerHandoff {
+    public:
+        /* Starts listening for new processes on handoff socket at a temporary path next to given path. */
+        ListenerHandoff(const std::string &handoffSocketPath, Scheduler &scheduler);
+
+        /* Closes handoff socket. Once published, the path is not removed, as it may belong to the new process already. */
+        ~ListenerHandoff() {
+            scheduler.forget(handoffDescriptor);
+            close(handoffDescriptor);
+
+            if (!published) {
+                unlink(temporaryPath.c_str());
+            }
+        }
+
+        ListenerHandoff(const ListenerHandoff &) = delete;
+
+        ListenerHandoff &operator=(const ListenerHandoff &) = delete;
+
+        /* Moves handoff socket to its path, replacing the one of the previous process.
+         * Must be called once the takeover, if any, has been confirmed. */
+        void publish();
+
+        /* Passes listening socket to new processes until one of them confirms the takeover. */
+        Task<void> handOver(int listenerDescriptor);
+
+    private:
+        /* Passes listening socket to the new process connected with given socket.
+         * Returns true if the new process has confirmed the takeover. */
+        Task<bool> handOverTo(int controlDescriptor, int listenerDescriptor);
+
+        /* Listening Unix socket through which new processes connect. */
+        int handoffDescriptor;
+
+        /* Path at which new processes look for the handoff socket. */
+        std::string handoffSocketPath;
+
+        /* Path at which the handoff socket is bound until it is published. */
+        std::string temporaryPath;
+
+        bool published = false;
+
+        Scheduler &scheduler;
+    };
+}
+
+#endif //SIKZAD1_LISTENERHANDOFF_H
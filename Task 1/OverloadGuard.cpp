@@ -0,0 +1,74 @@
+#include "OverloadGuard.h"
+
+namespace SIK {
+    OverloadGuard::OverloadGuard(const OverloadLimits &limits, Scheduler &scheduler, const TCPSocket &socket,
+                                 const std::string &serverName) : limits{limits}, scheduler{scheduler},
+                                                                  socket{socket} {
+        std::ostringstream stream;
+
+        stream << "HTTP/1.1 503 Service Unavailable\r\n"
+               << "Retry-After: " << limits.retryAfterSeconds << "\r\n"
+               << "Content-Length: 0\r\n"
+               << "Connection: close\r\n"
+               << "Server: " << serverName << "\r\n"
+               << "\r\n";
+
+        serviceUnavailableResponse = stream.str();
+    }
+
+    bool OverloadGuard::isOverloaded() const {
+        if (limits.maxConnections > 0 && openConnections >= limits.maxConnections) {
+            return true;
+        }
+
+        if (limits.maxInFlightRequests > 0 && inFlightRequests >= limits.maxInFlightRequests) {
+            return true;
+        }
+
+        if (limits.maxLoopLag.count() > 0 && scheduler.loopLag() > limits.maxLoopLag) {
+            return true;
+        }
+
+        /* Checked last, as it is the only check requiring a system call. */
+        return limits.maxAcceptQueue > 0 && socket.pendingConnections() >= limits.maxAcceptQueue;
+    }
+
+    Task<void> OverloadGuard::shed(std::unique_ptr<TCPSocket::ClientConnection> client) {
+        /* Freshly accepted socket has empty send buffer, so the response is not expected
+         * to block. If it does, the client is simply disconnected. */
+        if (limits.shedMode != ShedMode::SERVICE_UNAVAILABLE || !client->trySendText(serviceUnavailableResponse)) {
+            co_return;
+        }
+
+        client->shutdownWriting();
+
+        if (lingeringConnections >= MAX_LINGERING_CONNECTIONS) {
+            co_return;
+        }
+
+        Tracker lingeringTracker{lingeringConnections};
+
+        /* Closing the socket with the request unread would make the kernel reset the connection,
+         * which may discard the response before the client reads it. Data from the client is
+         * discarded until it closes the connection, for a limited time. */
+        char buffer[4096];
+        size_t bytesDrained = 0;
+        auto deadline = std::chrono::steady_clock::now() + SHED_LINGER_TIMEOUT;
+
+        while (bytesDrained < MAX_SHED_DRAIN) {
+            ssize_t bytesRead = client->tryReadData(buffer, sizeof(buffer));
+
+            if (bytesRead > 0) {
+                bytesDrained += bytesRead;
+                continue;
+            }
+
+            if (bytesRead == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) ||
+                std::chrono::steady_clock::now() >= deadline) {
+                co_return;
+            }
+
+            co_await client->readable(deadline);
+        }
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef SIKZAD1_OVERLOADGUARD_H
+#define SIKZAD1_OVERLOADGUARD_H
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "Scheduler.h"
+#include "TCPSocket.h"
+
+namespace SIK {
+    /* Way of rejecting connections when the server is overloaded. */
+    enum class ShedMode {
+        SERVICE_UNAVAILABLE,
+        CLOSE
+    };
+
+    /* Thresholds above which the server is considered overloaded. Zero disables given threshold. */
+    struct OverloadLimits {
+        /* Maximum number of open client connections. */
+        size_t maxConnections = 0;
+
+        /* Maximum number of requests being performed at the same time. */
+        size_t maxInFlightRequests = 0;
+
+        /* Maximum number of connections awaiting in the listen queue. */
+        size_t maxAcceptQueue = 0;
+
+        /* Maximum duration of a single event loop iteration. */
+        std::chrono::milliseconds maxLoopLag{0};
+
+        /* Value of Retry-After field sent with 503 Service Unavailable. */
+        unsigned retryAfterSeconds = 1;
+
+        /* Way of rejecting excess connections. */
+        ShedMode shedMode = ShedMode::SERVICE_UNAVAILABLE;
+    };
+
+    /* Class deciding whether new clients should be admitted. Existing connections are
+     * never shed, so keep-alive clients finish their work before new ones get in. */
+    class OverloadGuard {
+    public:
+        OverloadGuard(const OverloadLimits &limits, Scheduler &scheduler, const TCPSocket &socket,
+                      const std::string &serverName);
+
+        /* Copy and move semantics are disabled, as trackers keep references to the guard. */
+        OverloadGuard(const OverloadGuard &) = delete;
+
+        OverloadGuard &operator=(const OverloadGuard &) = delete;
+
+        /* Counter incremented for the lifetime of the tracker. */
+        class Tracker {
+        public:
+            explicit Tracker(size_t &counter) : counter{&counter} {
+                counter++;
+            }
+
+            Tracker(Tracker &&other) noexcept: counter{std::exchange(other.counter, nullptr)} {}
+
+            ~Tracker() {
+                if (counter != nullptr) {
+                    (*counter)--;
+                }
+            }
+
+            Tracker(const Tracker &) = delete;
+
+            Tracker &operator=(const Tracker &) = delete;
+
+        private:
+            size_t *counter;
+        };
+
+        /* Marks connection as open for the lifetime of returned object. */
+        [[nodiscard]] Tracker trackConnection() {
+            return Tracker{openConnections};
+        }
+
+        /* Marks request as being performed for the lifetime of returned object. */
+        [[nodiscard]] Tracker trackRequest() {
+            return Tracker{inFlightRequests};
+        }
+
+        /* Returns true if newly accepted client should be rejected. */
+        [[nodiscard]] bool isOverloaded() const;
+
+        /* Rejects the client according to the configured shed mode, closing the connection once done. */
+        Task<void> shed(std::unique_ptr<TCPSocket::ClientConnection> client);
+
+    private:
+        /* Longest time a rejected client is given to read the response and close the connection. */
+        static constexpr std::chrono::milliseconds SHED_LINGER_TIMEOUT{1000};
+
+        /* Maximum amount of data discarded from a rejected client. */
+        static constexpr size_t MAX_SHED_DRAIN = 65536;
+
+        /* Maximum number of rejected connections lingering at the same time. Excess ones are closed right away. */
+        static constexpr size_t MAX_LINGERING_CONNECTIONS = 256;
+
+        OverloadLimits limits;
+
+        Scheduler &scheduler;
+
+        const TCPSocket &socket;
+
+        /* Precomputed 503 Service Unavailable response. */
+        std::string serviceUnavailableResponse;
+
+        size_t openConnections = 0;
+
+        size_t inFlightRequests = 0;
+
+        size_t lingeringConnections = 0;
+    };
+}
+
+#endif //SIKZAD1_OVERLOADGUARD_H
@@ -0,0 +1,213 @@
+#include "RequestTracer.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include <unistd.h>
+
+namespace {
+    /* Returns name of the phase, as shown in dumps and traces. */
+    const char *phaseName(SIK::TracePhase phase) {
+        switch (phase) {
+            case SIK::TracePhase::ACCEPTED:
+                return "accepted";
+            case SIK::TracePhase::REQUEST_RECEIVED:
+                return "request received";
+            case SIK::TracePhase::REQUEST_PARSED:
+                return "request parsed";
+            case SIK::TracePhase::RESOURCE_RESOLVED:
+                return "resource resolved";
+            case SIK::TracePhase::HEAD_SENT:
+                return "head sent";
+            case SIK::TracePhase::BODY_SENT:
+                return "body sent";
+            case SIK::TracePhase::FINISHED:
+                return "finished";
+        }
+
+        return "unknown";
+    }
+
+    /* Writes string as JSON string literal. */
+    void writeJSONString(std::ostream &stream, const std::string &string) {
+        stream << '"';
+
+        for (unsigned char c : string) {
+            if (c == '"' || c == '\\') {
+                stream << '\\' << c;
+            } else if (c < 0x20) {
+                char escaped[7];
+                snprintf(escaped, sizeof escaped, "\\u%04x", c);
+                stream << escaped;
+            } else {
+                stream << c;
+            }
+        }
+
+        stream << '"';
+    }
+}
+
+namespace SIK {
+    thread_local std::vector<RequestTrace> RequestTracer::ring;
+
+    thread_local uint64_t RequestTracer::recordCount = 0;
+
+    RequestTracer::RequestTracer(const TraceOptions &options)
+            : sampleInterval{options.sampleInterval}, slowRequestTicks{0},
+              chromeTracePath{options.chromeTracePath}, epochTicks{TraceClock::now()} {
+
+        if (sampleInterval == 0) {
+            return;
+        }
+
+#if defined(__x86_64__) || defined(__i386__)
+        /* Frequency of the time stamp counter is not known, it is measured against the steady clock. */
+        auto calibrationStart = std::chrono::steady_clock::now();
+        uint64_t calibrationStartTicks = TraceClock::now();
+
+        std::this_thread::sleep_for(CALIBRATION_PERIOD);
+
+        uint64_t calibrationTicks = TraceClock::now() - calibrationStartTicks;
+        auto calibrationTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() -
+                                                                         calibrationStart);
+
+        ticksPerMicrosecond = static_cast<double>(calibrationTicks) / calibrationTime.count();
+#endif
+
+        slowRequestTicks = static_cast<uint64_t>(static_cast<double>(options.slowRequestThreshold.count()) * 1000.0 *
+                                                 ticksPerMicrosecond);
+    }
+
+    void RequestTracer::finish(RequestTrace &trace) {
+        if (!trace.sampled) {
+            return;
+        }
+
+        trace.mark(TracePhase::FINISHED);
+        trace.sampled = false;
+
+        if (ring.empty()) {
+            ring.resize(RING_CAPACITY);
+        }
+
+        RequestTrace &record = ring[recordCount++ % RING_CAPACITY];
+
+        record.markCount = trace.markCount;
+        record.marks = trace.marks;
+        record.requestNumber = trace.requestNumber;
+        record.status = trace.status;
+        record.resource = std::move(trace.resource);
+
+        uint64_t duration = record.marks[record.markCount - 1].ticks - record.marks[requestStart(record)].ticks;
+
+        if (slowRequestTicks > 0 && duration >= slowRequestTicks) {
+            dump(record);
+        }
+    }
+
+    void RequestTracer::dump(const RequestTrace &trace) const {
+        const auto &marks = trace.marks;
+        size_t start = requestStart(trace);
+        uint64_t duration = marks[trace.markCount - 1].ticks - marks[start].ticks;
+
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "Slow request " << (trace.resource.empty() ? "(unparsed)" : trace.resource) << " with status "
+                  << trace.status << " took " << toMicroseconds(duration) / 1000.0 << " ms:" << std::endl;
+
+        if (start > 0) {
+            std::cout << "    (connection accepted " << toMicroseconds(marks[start].ticks - marks[0].ticks) / 1000.0
+                      << " ms before the request)" << std::endl;
+        }
+
+        for (size_t i = start; i < trace.markCount; i++) {
+            std::cout << "    " << std::left << std::setw(20) << phaseName(marks[i].phase) << std::right
+                      << " at " << std::setw(10) << toMicroseconds(marks[i].ticks - marks[start].ticks) / 1000.0
+                      << " ms";
+
+            if (i > start) {
+                std::cout << " (+" << toMicroseconds(marks[i].ticks - marks[i - 1].ticks) / 1000.0 << " ms)";
+            }
+
+            std::cout << std::endl;
+        }
+
+        std::cout << std::defaultfloat;
+    }
+
+    void RequestTracer::exportChromeTrace() {
+        if (chromeTracePath.empty() || recordCount == exportedRecordCount) {
+            return;
+        }
+
+        exportedRecordCount = recordCount;
+
+        uint64_t firstRecord = recordCount > RING_CAPACITY ? recordCount - RING_CAPACITY : 0;
+        auto processId = getpid();
+
+        /* Trace is written aside and renamed, so that viewers never see it half written. */
+        std::string temporaryPath = chromeTracePath + ".tmp";
+
+        {
+            std::ofstream file{temporaryPath, std::ios::trunc};
+            bool first = true;
+
+            file << std::fixed << std::setprecision(3);
+            file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+            /* Every request is shown as a separate thread, with its phases nested in it. */
+            auto writeEvent = [&](const std::string &name, const char *category, uint64_t requestNumber,
+                                  uint64_t beginTicks, uint64_t endTicks, unsigned status) {
+                file << (first ? "\n" : ",\n") << "{\"name\":";
+                writeJSONString(file, name);
+                file << ",\"cat\":\"" << category << "\",\"ph\":\"X\",\"pid\":" << processId
+                     << ",\"tid\":" << requestNumber
+                     << ",\"ts\":" << toMicroseconds(beginTicks - epochTicks)
+                     << ",\"dur\":" << toMicroseconds(endTicks - beginTicks);
+
+                if (status != 0) {
+                    file << ",\"args\":{\"status\":" << status << "}";
+                }
+
+                file << "}";
+                first = false;
+            };
+
+            for (uint64_t i = firstRecord; i < recordCount; i++) {
+                const RequestTrace &record = ring[i % RING_CAPACITY];
+                const auto &marks = record.marks;
+                size_t start = requestStart(record);
+
+                /* Wait for the first request of a connection is shown apart from the request itself. */
+                if (start > 0) {
+                    writeEvent("awaiting first request", "connection", record.requestNumber, marks[0].ticks,
+                               marks[start].ticks, 0);
+                }
+
+                writeEvent(record.resource.empty() ? "(unparsed)" : record.resource, "request",
+                           record.requestNumber, marks[start].ticks, marks[record.markCount - 1].ticks,
+                           record.status);
+
+                /* Phase spans from the previous mark until its own mark. */
+                for (size_t j = start + 1; j < record.markCount; j++) {
+                    writeEvent(phaseName(marks[j].phase), "phase", record.requestNumber, marks[j - 1].ticks,
+                               marks[j].ticks, 0);
+                }
+            }
+
+            file << "\n]}\n";
+
+            if (!file) {
+                std::cout << "Exporting request traces failed!" << std::endl;
+                return;
+            }
+        }
+
+        if (rename(temporaryPath.c_str(), chromeTracePath.c_str()) < 0) {
+            std::cout << "Exporting request traces failed!" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,201 @@
+#ifndef SIKZAD1_REQUESTTRACER_H
+#define SIKZAD1_REQUESTTRACER_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace SIK {
+    /* Source of cheap timestamps. On x86 it reads the time stamp counter, elsewhere the coarse monotonic clock. */
+    class TraceClock {
+    public:
+        static uint64_t now() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            timespec time{};
+            clock_gettime(CLOCK_MONOTONIC_COARSE, &time);
+
+            return static_cast<uint64_t>(time.tv_sec) * 1'000'000'000 + time.tv_nsec;
+#endif
+        }
+    };
+
+    /* Phases of serving a request, in the order in which they happen. */
+    enum class TracePhase : uint8_t {
+        /* Connection has been accepted, recorded for its first request only. Time until
+         * the request is received is spent by the client, so it is not counted as latency. */
+        ACCEPTED,
+
+        /* Request line or HTTP/2 header block has been received. */
+        REQUEST_RECEIVED,
+
+        REQUEST_PARSED,
+
+        /* Requested resource has been looked up. */
+        RESOURCE_RESOLVED,
+
+        HEAD_SENT,
+
+        BODY_SENT,
+
+        FINISHED
+    };
+
+    /* Timestamps of phases of a single request. Phases are recorded only if the request is sampled. */
+    class RequestTrace {
+    public:
+        /* Maximum amount of recorded phases. */
+        static constexpr size_t MAX_MARKS = 8;
+
+        struct Mark {
+            TracePhase phase;
+            uint64_t ticks;
+        };
+
+        /* Records the current moment as the moment of the phase. */
+        void mark(TracePhase phase) noexcept {
+            if (sampled) {
+                markAt(phase, TraceClock::now());
+            }
+        }
+
+        /* Records given moment as the moment of the phase. */
+        void markAt(TracePhase phase, uint64_t ticks) noexcept {
+            if (sampled && markCount < MAX_MARKS) {
+                marks[markCount++] = {phase, ticks};
+            }
+        }
+
+        /* Records the moment the head of the response with given status has been sent. */
+        void markHeadSent(unsigned responseStatus) noexcept {
+            if (sampled) {
+                status = responseStatus;
+                markAt(TracePhase::HEAD_SENT, TraceClock::now());
+            }
+        }
+
+        /* Records target of the request. */
+        void setResource(const std::string &target) {
+            if (sampled) {
+                resource = target;
+            }
+        }
+
+        [[nodiscard]] bool isSampled() const noexcept {
+            return sampled;
+        }
+
+    private:
+        friend class RequestTracer;
+
+        bool sampled = false;
+
+        uint8_t markCount = 0;
+
+        std::array<Mark, MAX_MARKS> marks;
+
+        /* Number of the request among all requests started by the tracer. */
+        uint64_t requestNumber = 0;
+
+        unsigned status = 0;
+
+        std::string resource;
+    };
+
+    /* Configuration of request tracing. */
+    struct TraceOptions {
+        /* Every sampleInterval-th request is traced. Zero disables tracing. */
+        uint64_t sampleInterval = 0;
+
+        /* Traced requests taking at least that long are dumped. Zero disables dumps. */
+        std::chrono::milliseconds slowRequestThreshold{0};
+
+        /* Path of file to which traced requests are exported in Chrome trace format. Empty disables export. */
+        std::string chromeTracePath;
+    };
+
+    /* Samples requests for tracing, dumps slow ones and keeps the most recent traces in a ring buffer
+     * of the thread serving them, from which they are exported in Chrome trace format (viewable in
+     * chrome://tracing or Perfetto). Requests which are not sampled cost a single comparison per phase. */
+    class RequestTracer {
+    public:
+        explicit RequestTracer(const TraceOptions &options);
+
+        RequestTracer(const RequestTracer &) = delete;
+
+        RequestTracer &operator=(const RequestTracer &) = delete;
+
+        /* Returns true if requests are traced at all. */
+        [[nodiscard]] bool isEnabled() const noexcept {
+            return sampleInterval != 0;
+        }
+
+        /* Starts trace of a new request, deciding whether it is sampled. */
+        void start(RequestTrace &trace) noexcept {
+            trace.sampled = sampleInterval != 0 && ++requestCount % sampleInterval == 0;
+            trace.markCount = 0;
+            trace.requestNumber = requestCount;
+            trace.status = 0;
+        }
+
+        /* Ends trace of the request, storing it in the ring buffer and dumping it if it was slow. */
+        void finish(RequestTrace &trace);
+
+        /* Writes traces from the ring buffer to the Chrome trace file, if something new has been traced. */
+        void exportChromeTrace();
+
+    private:
+        /* Capacity of the ring buffer of traces. */
+        static constexpr size_t RING_CAPACITY = 4096;
+
+        /* Time over which the time stamp counter is calibrated. */
+        static constexpr std::chrono::milliseconds CALIBRATION_PERIOD{20};
+
+        /* Recently finished traces of the thread, the oldest overwritten first. */
+        static thread_local std::vector<RequestTrace> ring;
+
+        /* Total amount of traces stored in the ring buffer of the thread. */
+        static thread_local uint64_t recordCount;
+
+        /* Returns index of the mark at which the request has been received. */
+        static size_t requestStart(const RequestTrace &trace) {
+            return trace.markCount > 1 && trace.marks[0].phase == TracePhase::ACCEPTED ? 1 : 0;
+        }
+
+        /* Prints phase breakdown of the trace. */
+        void dump(const RequestTrace &trace) const;
+
+        /* Converts difference of timestamps to microseconds. */
+        [[nodiscard]] double toMicroseconds(uint64_t ticks) const {
+            return static_cast<double>(ticks) / ticksPerMicrosecond;
+        }
+
+        uint64_t sampleInterval;
+
+        uint64_t slowRequestTicks;
+
+        std::string chromeTracePath;
+
+        /* Amount of requests started so far. */
+        uint64_t requestCount = 0;
+
+        /* Value of recordCount during the last export. */
+        uint64_t exportedRecordCount = 0;
+
+        /* Frequency of the trace clock. */
+        double ticksPerMicrosecond = 1000.0;
+
+        /* Timestamp from which times in the Chrome trace are counted. */
+        uint64_t epochTicks;
+    };
+}
+
+#endif //SIKZAD1_REQUESTTRACER_H
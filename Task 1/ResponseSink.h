@@ -0,0 +1,44 @@
+#ifndef SIKZAD1_RESPONSESINK_H
+#define SIKZAD1_RESPONSESINK_H
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "RequestTracer.h"
+#include "Task.h"
+
+namespace SIK {
+    /* Header field of a request or a response. */
+    struct HeaderField {
+        std::string name;
+        std::string value;
+    };
+
+    /* Destination of a response, which frames it according to the protocol spoken with the client:
+     * HTTP/1.1 connection or a single HTTP/2 stream. Response consists of the head, optionally
+     * followed by exactly one body - a range of a file. */
+    class ResponseSink {
+    public:
+        virtual ~ResponseSink() = default;
+
+        /* Sends status and header fields of the response. */
+        virtual Task<void> sendHead(unsigned status, const char *reason, const std::vector<HeaderField> &fields) = 0;
+
+        /* Sends count bytes of the file starting at offset as the body of the response. */
+        virtual Task<void> sendFileRange(int fileDescriptor, off64_t offset, size_t count) = 0;
+
+        /* Sends the whole file as the body of the response. */
+        virtual Task<void> sendFile(const std::filesystem::path &filePath) = 0;
+
+        /* Phases of the request to which the response is being sent. */
+        RequestTrace trace;
+
+        /* True once sending of the current response has begun, so that it cannot be replaced by another one. */
+        bool responseStarted = false;
+    };
+}
+
+#endif //SIKZAD1_RESPONSESINK_H
@@ -0,0 +1,186 @@
+#include "Scheduler.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace SIK {
+    Scheduler::Scheduler() {
+        epollDescriptor = epoll_create1(EPOLL_CLOEXEC);
+
+        if (epollDescriptor < 0) {
+            throw SchedulerCreateException{};
+        }
+    }
+
+    void Scheduler::spawn(Task<void> task) {
+        readyQueue.push_back(runDetached(std::move(task)).handle);
+    }
+
+    Scheduler::DetachedTask Scheduler::runDetached(Task<void> task) {
+        try {
+            co_await std::move(task);
+        } catch (const std::exception &e) {
+            std::cout << e.what() << std::endl;
+        }
+    }
+
+    void Scheduler::forget(int descriptor) {
+        auto it = waitersByDescriptor.find(descriptor);
+
+        if (it == waitersByDescriptor.end()) {
+            return;
+        }
+
+        if (it->second.registered) {
+            epoll_ctl(epollDescriptor, EPOLL_CTL_DEL, descriptor, nullptr);
+        }
+
+        waitersByDescriptor.erase(it);
+    }
+
+    void Scheduler::addWaiter(int descriptor, bool forWriting, std::coroutine_handle<> handle,
+                              std::chrono::steady_clock::time_point deadline) {
+        Waiters &waiters = waitersByDescriptor[descriptor];
+
+        (forWriting ? waiters.writer : waiters.reader) = handle;
+        uint64_t wait = (forWriting ? waiters.writerWait : waiters.readerWait) = ++waitCount;
+
+        updateInterest(descriptor, waiters);
+
+        if (deadline != NO_DEADLINE) {
+            timers.push({deadline, handle, descriptor, forWriting, wait});
+        }
+    }
+
+    void Scheduler::expire(const Timer &timer) {
+        if (timer.descriptor < 0) {
+            readyQueue.push_back(timer.handle);
+            return;
+        }
+
+        auto it = waitersByDescriptor.find(timer.descriptor);
+
+        if (it == waitersByDescriptor.end()) {
+            return;
+        }
+
+        Waiters &waiters = it->second;
+        auto &waiter = timer.forWriting ? waiters.writer : waiters.reader;
+
+        if (!waiter || (timer.forWriting ? waiters.writerWait : waiters.readerWait) != timer.wait) {
+            return;
+        }
+
+        readyQueue.push_back(std::exchange(waiter, nullptr));
+        updateInterest(timer.descriptor, waiters);
+    }
+
+    void Scheduler::updateInterest(int descriptor, Waiters &waiters) {
+        epoll_event event{};
+
+        event.data.fd = descriptor;
+        event.events = (waiters.reader ? EPOLLIN : 0u) | (waiters.writer ? EPOLLOUT : 0u);
+
+        /* Descriptors nobody waits for are removed from epoll, as otherwise
+         * errors and hang-ups on them would be reported over and over again. */
+        if (event.events == 0) {
+            if (waiters.registered && epoll_ctl(epollDescriptor, EPOLL_CTL_DEL, descriptor, nullptr) < 0) {
+                throw SchedulerWaitException{};
+            }
+
+            waiters.registered = false;
+            return;
+        }
+
+        if (epoll_ctl(epollDescriptor, waiters.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                      descriptor, &event) < 0) {
+            throw SchedulerWaitException{};
+        }
+
+        waiters.registered = true;
+    }
+
+    void Scheduler::run() {
+        epoll_event events[MAX_EVENTS];
+
+        while (true) {
+            auto iterationStart = std::chrono::steady_clock::now();
+
+            while (!readyQueue.empty()) {
+                auto handle = readyQueue.front();
+                readyQueue.pop_front();
+
+                handle.resume();
+            }
+
+            lastIterationDuration = std::chrono::steady_clock::now() - iterationStart;
+
+            int eventCount = epoll_wait(epollDescriptor, events, MAX_EVENTS, waitTimeout());
+
+            if (eventCount < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                throw SchedulerWaitException{};
+            }
+
+            for (int i = 0; i < eventCount; i++) {
+                auto it = waitersByDescriptor.find(events[i].data.fd);
+
+                if (it == waitersByDescriptor.end()) {
+                    continue;
+                }
+
+                Waiters &waiters = it->second;
+
+                /* Errors and hang-ups wake up everyone - the following system call will report them. */
+                bool failed = events[i].events & (EPOLLERR | EPOLLHUP);
+
+                if (waiters.reader && (failed || events[i].events & EPOLLIN)) {
+                    readyQueue.push_back(std::exchange(waiters.reader, nullptr));
+                }
+
+                if (waiters.writer && (failed || events[i].events & EPOLLOUT)) {
+                    readyQueue.push_back(std::exchange(waiters.writer, nullptr));
+                }
+
+                updateInterest(it->first, waiters);
+            }
+
+            auto now = std::chrono::steady_clock::now();
+
+            while (!timers.empty() && timers.top().deadline <= now) {
+                Timer timer = timers.top();
+                timers.pop();
+
+                expire(timer);
+            }
+
+            readyQueue.insert(readyQueue.end(), deferredQueue.begin(), deferredQueue.end());
+            deferredQueue.clear();
+        }
+    }
+
+    int Scheduler::waitTimeout() const {
+        /* Yielded coroutines only want to let others go first, so there is no point in sleeping. */
+        if (!deferredQueue.empty()) {
+            return 0;
+        }
+
+        if (timers.empty()) {
+            return -1;
+        }
+
+        auto remaining = timers.top().deadline - std::chrono::steady_clock::now();
+
+        if (remaining <= std::chrono::steady_clock::duration::zero()) {
+            return 0;
+        }
+
+        /* Rounding up, so that the loop does not wake up just before the deadline. */
+        auto milliseconds = std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+
+        return static_cast<int>(std::min<int64_t>(milliseconds, std::numeric_limits<int>::max()));
+    }
+}
@@ -0,0 +1,260 @@
+#ifndef SIKZAD1_SCHEDULER_H
+#define SIKZAD1_SCHEDULER_H
+
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <iostream>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "Auxiliary.h"
+#include "Task.h"
+
+namespace SIK {
+    class SchedulerCreateException : public ServerException {
+    public:
+        [[nodiscard]] const char *what() const noexcept override {
+            return "Creating event loop failed!";
+        }
+    };
+
+    class SchedulerWaitException : public ServerException {
+    public:
+        [[nodiscard]] const char *what() const noexcept override {
+            return "Waiting for descriptor readiness failed!";
+        }
+    };
+
+    /* Single-threaded event loop driving coroutines. Coroutines suspend on descriptors
+     * which are not ready and get resumed once epoll reports them as ready. */
+    class Scheduler {
+    public:
+        /* Creates epoll instance. */
+        Scheduler();
+
+        /* Closes epoll instance. */
+        ~Scheduler() {
+            close(epollDescriptor);
+        }
+
+        /* Copy and move semantics are disabled, as coroutines keep references to the scheduler. */
+        Scheduler(const Scheduler &) = delete;
+
+        Scheduler &operator=(const Scheduler &) = delete;
+
+        /* Awaitable suspending coroutine until descriptor is ready for reading or writing,
+         * or until the deadline passes, whichever comes first. */
+        class ReadinessAwaiter {
+        public:
+            ReadinessAwaiter(Scheduler &scheduler, int descriptor, bool forWriting,
+                             std::chrono::steady_clock::time_point deadline = NO_DEADLINE)
+                    : scheduler{scheduler}, descriptor{descriptor}, forWriting{forWriting}, deadline{deadline} {}
+
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                scheduler.addWaiter(descriptor, forWriting, handle, deadline);
+            }
+
+            void await_resume() const noexcept {}
+
+        private:
+            Scheduler &scheduler;
+            int descriptor;
+            bool forWriting;
+            std::chrono::steady_clock::time_point deadline;
+        };
+
+        /* Suspends coroutine until descriptor is ready for reading. */
+        ReadinessAwaiter readable(int descriptor) {
+            return {*this, descriptor, false};
+        }
+
+        /* Suspends coroutine until descriptor is ready for reading or the deadline passes.
+         * The coroutine has to find out which of them has happened by itself. */
+        ReadinessAwaiter readable(int descriptor, std::chrono::steady_clock::time_point deadline) {
+            return {*this, descriptor, false, deadline};
+        }
+
+        /* Suspends coroutine until descriptor is ready for writing. */
+        ReadinessAwaiter writable(int descriptor) {
+            return {*this, descriptor, true};
+        }
+
+        /* Awaitable suspending coroutine until the next iteration of the event loop,
+         * so that coroutines woken up by epoll in the meantime run first. */
+        class YieldAwaiter {
+        public:
+            explicit YieldAwaiter(Scheduler &scheduler) : scheduler{scheduler} {}
+
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                scheduler.deferredQueue.push_back(handle);
+            }
+
+            void await_resume() const noexcept {}
+
+        private:
+            Scheduler &scheduler;
+        };
+
+        /* Suspends coroutine until the next iteration of the event loop. */
+        YieldAwaiter yield() {
+            return YieldAwaiter{*this};
+        }
+
+        /* Schedules coroutine, suspended by its own awaiter, to be resumed by the event loop. */
+        void wake(std::coroutine_handle<> handle) {
+            readyQueue.push_back(handle);
+        }
+
+        /* Awaitable suspending coroutine until the deadline passes. Timers take no descriptors,
+         * so sleeping works even when the process has run out of them. */
+        class SleepAwaiter {
+        public:
+            SleepAwaiter(Scheduler &scheduler, std::chrono::steady_clock::time_point deadline)
+                    : scheduler{scheduler}, deadline{deadline} {}
+
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                scheduler.timers.push({deadline, handle, -1, false, 0});
+            }
+
+            void await_resume() const noexcept {}
+
+        private:
+            Scheduler &scheduler;
+            std::chrono::steady_clock::time_point deadline;
+        };
+
+        /* Suspends coroutine for given duration. */
+        SleepAwaiter sleep(std::chrono::milliseconds duration) {
+            return {*this, std::chrono::steady_clock::now() + duration};
+        }
+
+        /* Schedules task to be run by the event loop. The scheduler owns the task
+         * until it finishes. Exceptions leaving the task are reported and dropped. */
+        void spawn(Task<void> task);
+
+        /* Removes all information about descriptor. Must be called before closing it. */
+        void forget(int descriptor);
+
+        /* Runs event loop. */
+        [[noreturn]] void run();
+
+        /* Returns how long the last iteration of the event loop took to resume all
+         * ready coroutines. Events reported during that time waited that long. */
+        [[nodiscard]] std::chrono::steady_clock::duration loopLag() const {
+            return lastIterationDuration;
+        }
+
+    private:
+        /* Maximum amount of events fetched by single epoll_wait call. */
+        static constexpr int MAX_EVENTS = 256;
+
+        /* Deadline of waits for descriptors which are not limited in time. */
+        static constexpr std::chrono::steady_clock::time_point NO_DEADLINE = std::chrono::steady_clock::time_point::max();
+
+        /* Coroutine sleeping until the deadline, or waiting for a descriptor at most until then. */
+        struct Timer {
+            std::chrono::steady_clock::time_point deadline;
+            std::coroutine_handle<> handle;
+
+            /* Descriptor waited for, -1 if the coroutine is just sleeping. */
+            int descriptor;
+            bool forWriting;
+
+            /* Number of the wait for the descriptor. Timers of waits which have already ended are ignored. */
+            uint64_t wait;
+
+            bool operator>(const Timer &other) const {
+                return deadline > other.deadline;
+            }
+        };
+
+        /* Coroutines suspended on a descriptor. */
+        struct Waiters {
+            std::coroutine_handle<> reader;
+            std::coroutine_handle<> writer;
+            bool registered = false;
+
+            /* Numbers of the current waits, matched against their timers. */
+            uint64_t readerWait = 0;
+            uint64_t writerWait = 0;
+        };
+
+        /* Coroutine type owning spawned task. Starts suspended and frees itself when finished. */
+        struct DetachedTask {
+            struct promise_type : PooledFrame {
+                DetachedTask get_return_object() noexcept {
+                    return {std::coroutine_handle<promise_type>::from_promise(*this)};
+                }
+
+                std::suspend_always initial_suspend() noexcept {
+                    return {};
+                }
+
+                std::suspend_never final_suspend() noexcept {
+                    return {};
+                }
+
+                void return_void() noexcept {}
+
+                void unhandled_exception() noexcept {}
+            };
+
+            std::coroutine_handle<promise_type> handle;
+        };
+
+        static DetachedTask runDetached(Task<void> task);
+
+        /* Registers coroutine as waiting for descriptor's readiness, at most until the deadline. */
+        void addWaiter(int descriptor, bool forWriting, std::coroutine_handle<> handle,
+                       std::chrono::steady_clock::time_point deadline);
+
+        /* Resumes coroutine whose timer has expired, unless it has been woken up by its descriptor already. */
+        void expire(const Timer &timer);
+
+        /* Updates epoll interest of descriptor to reflect its current waiters. */
+        void updateInterest(int descriptor, Waiters &waiters);
+
+        /* Returns epoll_wait timeout in milliseconds, until the earliest timer expires. */
+        [[nodiscard]] int waitTimeout() const;
+
+        /* Descriptor of the epoll instance. */
+        int epollDescriptor;
+
+        /* Coroutines ready to be resumed. */
+        std::deque<std::coroutine_handle<>> readyQueue;
+
+        /* Coroutines which yielded, resumed after the next epoll_wait. */
+        std::deque<std::coroutine_handle<>> deferredQueue;
+
+        /* Coroutines suspended on descriptors. */
+        std::unordered_map<int, Waiters> waitersByDescriptor;
+
+        /* Sleeping coroutines, the earliest deadline first. */
+        std::priority_queue<Timer, std::vector<Timer>, std::greater<>> timers;
+
+        /* Amount of waits for descriptors registered so far. */
+        uint64_t waitCount = 0;
+
+        /* Duration of the last iteration of the event loop. */
+        std::chrono::steady_clock::duration lastIterationDuration{};
+    };
+}
+
+#endif //SIKZAD1_SCHEDULER_H
@@ -1,56 +1,168 @@
 #include "TCPSocket.h"
 
 namespace SIK {
-    TCPSocket::TCPSocket(uint16_t port) {
-        listenerDescriptor = socket(AF_INET, SOCK_STREAM, 0);
+    TCPSocket::TCPSocket(uint16_t port, Scheduler &scheduler, const SocketOptions &options,
+                         std::optional<int> inheritedDescriptor) : scheduler{scheduler}, options{options} {
+        if (inheritedDescriptor) {
+            listenerDescriptor = inheritedDescriptor.value();
+            setListenerOptions();
+            return;
+        }
+
+        listenerDescriptor = socket(options.dualStack ? AF_INET6 : AF_INET,
+                                    SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
 
         if (listenerDescriptor < 0) {
             throw SocketCreateException{};
         }
 
-        sockaddr_in socketAddress{};
+        try {
+            setListenerOptions();
+        } catch (...) {
+            close(listenerDescriptor);
+            throw;
+        }
+
+        int bindResult;
+
+        if (options.dualStack) {
+            int v6Only = 0;
+
+            if (setsockopt(listenerDescriptor, IPPROTO_IPV6, IPV6_V6ONLY, &v6Only, sizeof(v6Only)) < 0) {
+                close(listenerDescriptor);
+                throw SocketOptionException{};
+            }
+
+            sockaddr_in6 socketAddress{};
+
+            socketAddress.sin6_family = AF_INET6;
+            socketAddress.sin6_addr = in6addr_any;
+            socketAddress.sin6_port = htons(port);
 
-        socketAddress.sin_family = AF_INET;
-        socketAddress.sin_addr.s_addr = htonl(INADDR_ANY);
-        socketAddress.sin_port = htons(port);
+            bindResult = bind(listenerDescriptor,
+                              reinterpret_cast<struct sockaddr *>(&socketAddress),
+                              sizeof(socketAddress));
+        } else {
+            sockaddr_in socketAddress{};
+
+            socketAddress.sin_family = AF_INET;
+            socketAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+            socketAddress.sin_port = htons(port);
+
+            bindResult = bind(listenerDescriptor,
+                              reinterpret_cast<struct sockaddr *>(&socketAddress),
+                              sizeof(socketAddress));
+        }
 
-        if (bind(listenerDescriptor,
-                 reinterpret_cast<struct sockaddr *>(&socketAddress),
-                 sizeof(socketAddress)) < 0) {
+        if (bindResult < 0) {
+            close(listenerDescriptor);
             throw SocketBindException{};
         }
+    }
+
+    void TCPSocket::setListenerOptions() const {
+        auto setOption = [this](int level, int name, int value) {
+            if (value != 0 && setsockopt(listenerDescriptor, level, name, &value, sizeof(value)) < 0) {
+                throw SocketOptionException{};
+            }
+        };
 
+        setOption(IPPROTO_TCP, TCP_DEFER_ACCEPT, options.deferAcceptSeconds);
+        setOption(IPPROTO_TCP, TCP_FASTOPEN, options.fastOpenQueue);
+
+        /* Buffer sizes have to be known before the handshake to negotiate window scaling,
+         * so they are set on the listening socket and inherited by accepted ones. */
+        setOption(SOL_SOCKET, SO_SNDBUF, options.sendBufferSize);
+        setOption(SOL_SOCKET, SO_RCVBUF, options.receiveBufferSize);
+
+        /* Accepted sockets inherit these as well, so a lacking privilege (e.g. CAP_NET_ADMIN
+         * for busy polling) is reported on start instead of being ignored for every client. */
+        setOption(IPPROTO_TCP, TCP_NODELAY, options.noDelay ? 1 : 0);
+        setOption(SOL_SOCKET, SO_BUSY_POLL, options.busyPollMicroseconds);
+    }
+
+    void TCPSocket::startListening() const {
+        /* Listening again is harmless, so inherited sockets need no special care. */
         if (listen(listenerDescriptor, MAX_LISTEN_QUEUE) < 0) {
             throw SocketListenException{};
         }
     }
 
-    ssize_t TCPSocket::ClientConnection::readData(char *buffer, size_t count) const {
-        ssize_t bytesRead;
+    Task<std::vector<std::unique_ptr<TCPSocket::ClientConnection>>> TCPSocket::acceptConnections() const {
+        std::vector<std::unique_ptr<ClientConnection>> clients;
 
-        do {
+        while (clients.size() < std::max<size_t>(options.acceptBatch, 1)) {
             errno = 0;
-            bytesRead = ::read(clientDescriptor, buffer, count);
-        } while (bytesRead < 0 && errno == EINTR);
+            int clientDescriptor = accept4(listenerDescriptor, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+            if (clientDescriptor >= 0) {
+                clients.push_back(std::make_unique<ClientConnection>(clientDescriptor, scheduler));
+                continue;
+            }
+
+            if (errno == EINTR) {
+                continue;
+            }
 
-        if (bytesRead < 0) {
-            throw ClientSocketReadException{};
+            if (!clients.empty()) {
+                break;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                co_await scheduler.readable(listenerDescriptor);
+            } else if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                throw ClientSocketLimitException{};
+            } else {
+                throw ClientSocketCreationException{};
+            }
         }
 
-        return bytesRead;
+        co_return clients;
+    }
+
+    size_t TCPSocket::pendingConnections() const {
+        tcp_info info{};
+        socklen_t infoLength = sizeof(info);
+
+        /* For listening sockets Linux reports length of the accept queue as tcpi_unacked. */
+        if (getsockopt(listenerDescriptor, IPPROTO_TCP, TCP_INFO, &info, &infoLength) < 0) {
+            return 0;
+        }
+
+        return info.tcpi_unacked;
+    }
+
+    Task<ssize_t> TCPSocket::ClientConnection::readData(char *buffer, size_t count) const {
+        while (true) {
+            errno = 0;
+            ssize_t bytesRead = ::read(clientDescriptor, buffer, count);
+
+            if (bytesRead >= 0) {
+                co_return bytesRead;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                co_await scheduler.readable(clientDescriptor);
+            } else if (errno != EINTR) {
+                throw ClientSocketReadException{};
+            }
+        }
     }
 
-    void TCPSocket::ClientConnection::sendText(const char *buffer, size_t count) const {
+    Task<void> TCPSocket::ClientConnection::sendText(const char *buffer, size_t count, bool more) const {
         auto bytesLeft = count;
 
         const char *ptr = buffer;
 
         while (bytesLeft > 0) {
             errno = 0;
-            auto bytesWritten = write(clientDescriptor, ptr, bytesLeft);
+            auto bytesWritten = send(clientDescriptor, ptr, bytesLeft, more ? MSG_MORE : 0);
 
             if (bytesWritten <= 0) {
-                if (bytesWritten < 0 && errno == EINTR) {
+                if (bytesWritten < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    co_await scheduler.writable(clientDescriptor);
+                    bytesWritten = 0;
+                } else if (bytesWritten < 0 && errno == EINTR) {
                     bytesWritten = 0;
                 } else {
                     throw ClientSocketWriteException{};
@@ -62,18 +174,27 @@ namespace SIK {
         }
     }
 
-    void TCPSocket::ClientConnection::sendFile(const std::filesystem::path &filePath) const {
+    Task<void> TCPSocket::ClientConnection::sendFile(const std::filesystem::path &filePath) const {
         auto fileSize = std::filesystem::file_size(filePath);
 
-        int fileDescriptor = open(filePath.c_str(), O_RDONLY);
+        int fileDescriptor = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
 
         if (fileDescriptor < 0) {
             throw OpeningFileException{};
         }
 
-        off64_t offset = 0;
+        try {
+            co_await sendFileRange(fileDescriptor, 0, fileSize);
+        } catch (...) {
+            close(fileDescriptor);
+            throw;
+        }
 
-        auto bytesLeft = fileSize;
+        close(fileDescriptor);
+    }
+
+    Task<void> TCPSocket::ClientConnection::sendFileRange(int fileDescriptor, off64_t offset, size_t count) const {
+        auto bytesLeft = count;
 
         while (bytesLeft > 0) {
             errno = 0;
@@ -81,7 +202,10 @@ namespace SIK {
                                            &offset, bytesLeft);
 
             if (bytesWritten <= 0) {
-                if (bytesWritten < 0 && errno == EINTR) {
+                if (bytesWritten < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    co_await scheduler.writable(clientDescriptor);
+                    bytesWritten = 0;
+                } else if (bytesWritten < 0 && errno == EINTR) {
                     bytesWritten = 0;
                 } else {
                     throw ClientSocketWriteException{};
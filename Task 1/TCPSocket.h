@@ -3,20 +3,25 @@
 
 #include <cstdint>
 #include <memory>
+#include <vector>
 #include <string>
 #include <algorithm>
 #include <sstream>
 #include <iostream>
 #include <regex>
 #include <filesystem>
+#include <optional>
 
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 
 #include "Auxiliary.h"
+#include "Scheduler.h"
+#include "Task.h"
 
 namespace SIK {
     class SocketCreateException : public ServerException {
@@ -47,6 +52,15 @@ namespace SIK {
         }
     };
 
+    /* Accepting failed as the process or the system ran out of descriptors or memory.
+     * Pending connections stay in the queue, so accepting should be retried later. */
+    class ClientSocketLimitException : public ClientSocketCreationException {
+    public:
+        [[nodiscard]] const char *what() const noexcept override {
+            return "Accepting connection with TCP socket failed, out of descriptors or memory!";
+        }
+    };
+
     class ClientSocketReadException : public ServerException {
     public:
         [[nodiscard]] const char *what() const noexcept override {
@@ -54,6 +68,13 @@ namespace SIK {
         }
     };
 
+    class ClientDisconnectedException : public ServerException {
+    public:
+        [[nodiscard]] const char *what() const noexcept override {
+            return "Client has closed the connection!";
+        }
+    };
+
     class ClientSocketWriteException : public ServerException {
     public:
         [[nodiscard]] const char *what() const noexcept override {
@@ -68,67 +89,176 @@ namespace SIK {
         }
     };
 
-    /* Class for managing TCP socket. */
+    class SocketOptionException : public ServerException {
+    public:
+        [[nodiscard]] const char *what() const noexcept override {
+            return "Setting TCP socket option failed!";
+        }
+    };
+
+    /* Tuning of the listening socket and client sockets. Zero leaves given setting to the system. */
+    struct SocketOptions {
+        /* Listen on IPv6 socket accepting IPv4 clients as well. */
+        bool dualStack = false;
+
+        /* Maximum number of connections accepted per wakeup of the listening socket. */
+        size_t acceptBatch = 16;
+
+        /* TCP_DEFER_ACCEPT - seconds for which connection is not accepted until the client sends data. */
+        int deferAcceptSeconds = 0;
+
+        /* TCP_FASTOPEN - length of the queue of pending Fast Open requests. */
+        int fastOpenQueue = 0;
+
+        /* TCP_NODELAY - disables Nagle's algorithm on client sockets, inherited from the listening socket. */
+        bool noDelay = false;
+
+        /* SO_BUSY_POLL - microseconds of busy polling the device queue on reads from client sockets,
+         * inherited from the listening socket. */
+        int busyPollMicroseconds = 0;
+
+        /* SO_SNDBUF and SO_RCVBUF of client sockets, inherited from the listening socket. */
+        int sendBufferSize = 0;
+        int receiveBufferSize = 0;
+    };
+
+    /* Class for managing TCP socket. All operations on the socket and on
+     * client connections are non-blocking and suspend the calling coroutine
+     * on the scheduler until they can make progress. */
     class TCPSocket {
     public:
-        /* Starts listening for TCP connections on given port. */
-        explicit TCPSocket(uint16_t port);
+        /* Binds TCP socket to given port. If inheritedDescriptor is given,
+         * the already listening socket is used instead. */
+        TCPSocket(uint16_t port, Scheduler &scheduler, const SocketOptions &options = {},
+                  std::optional<int> inheritedDescriptor = std::nullopt);
+
+        /* Starts listening for TCP connections. Until then connection attempts are refused. */
+        void startListening() const;
 
         /* Closes TCP socket. */
         ~TCPSocket() {
-            close(listenerDescriptor);
+            stopListening();
+        }
+
+        /* Closes TCP socket. Coroutine awaiting connection is never resumed. */
+        void stopListening() {
+            if (listenerDescriptor >= 0) {
+                scheduler.forget(listenerDescriptor);
+                close(listenerDescriptor);
+                listenerDescriptor = -1;
+            }
+        }
+
+        /* Returns descriptor of the listening socket. */
+        [[nodiscard]] int getDescriptor() const {
+            return listenerDescriptor;
         }
 
         /* Class for managing socket connection with client. */
         class ClientConnection {
         public:
-            /* Accepts awaiting connection on listener socket. */
-            explicit ClientConnection(int listenerDescriptor) {
-                clientDescriptor = accept(listenerDescriptor, nullptr, nullptr);
-
-                if (clientDescriptor < 0) {
-                    throw ClientSocketCreationException{};
-                }
-            }
+            /* Takes ownership of accepted non-blocking client socket. */
+            ClientConnection(int clientDescriptor, Scheduler &scheduler)
+                    : clientDescriptor{clientDescriptor}, scheduler{scheduler} {}
 
             /* Closes connection with a client. */
             ~ClientConnection() {
+                scheduler.forget(clientDescriptor);
                 close(clientDescriptor);
             }
 
+            ClientConnection(const ClientConnection &) = delete;
+
+            ClientConnection &operator=(const ClientConnection &) = delete;
+
             /* Reads UP TO count bytes from client to the given buffer.
              * Returns the amount of bytes read. */
-            ssize_t readData(char *buffer, size_t count) const;
+            Task<ssize_t> readData(char *buffer, size_t count) const;
+
+            /* Suspends coroutine until data from the client can be read or the deadline passes. */
+            Scheduler::ReadinessAwaiter readable(std::chrono::steady_clock::time_point deadline) const {
+                return scheduler.readable(clientDescriptor, deadline);
+            }
+
+            /* Reads up to count bytes from client to the given buffer, without waiting for the socket.
+             * Returns the amount of bytes read, or -1 with errno set to EAGAIN if there is nothing to read. */
+            ssize_t tryReadData(char *buffer, size_t count) const noexcept {
+                return recv(clientDescriptor, buffer, count, MSG_DONTWAIT);
+            }
 
             /* Sends count bytes from the buffer to the client.
-             * Retries until everything is sent. */
-            void sendText(const char *buffer, size_t count) const;
+             * Retries until everything is sent. If more is true, the text is held back
+             * to be sent together with the data following it (MSG_MORE). */
+            Task<void> sendText(const char *buffer, size_t count, bool more = false) const;
 
-            /* Calls sendText(buffer, count). */
-            void sendText(const std::string &text) const {
-                sendText(text.c_str(), text.size());
+            /* Calls sendText(buffer, count, more). The text must outlive the returned task,
+             * which holds when it is awaited in the same expression. */
+            Task<void> sendText(const std::string &text, bool more = false) const {
+                return sendText(text.c_str(), text.size(), more);
+            }
+
+            /* Tries to send the text with a single write, without waiting for the socket.
+             * Returns true if the whole text has been sent. */
+            bool trySendText(const std::string &text) const noexcept {
+                return send(clientDescriptor, text.c_str(), text.size(), MSG_DONTWAIT) ==
+                       static_cast<ssize_t>(text.size());
+            }
+
+            /* Disables Nagle's algorithm, so that small writes are not held back until earlier data is acknowledged. */
+            void setNoDelay() const noexcept {
+                int noDelay = 1;
+                setsockopt(clientDescriptor, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+            }
+
+            /* Stops receiving data from the client. Coroutine awaiting data is resumed
+             * and reads end of file. */
+            void shutdownReading() const noexcept {
+                shutdown(clientDescriptor, SHUT_RD);
+            }
+
+            /* Tells the client that nothing more is going to be sent, once the data sent so far arrives. */
+            void shutdownWriting() const noexcept {
+                shutdown(clientDescriptor, SHUT_WR);
             }
 
             /* Sends file of size fileSize pointed by fileDescriptor to client.
              * Retries until everything is sent. */
-            void sendFile(const std::filesystem::path &filePath) const;
+            Task<void> sendFile(const std::filesystem::path &filePath) const;
+
+            /* Sends count bytes of the file pointed by fileDescriptor, starting at offset, to client.
+             * Retries until everything is sent. */
+            Task<void> sendFileRange(int fileDescriptor, off64_t offset, size_t count) const;
 
         private:
             /* Descriptor of the client socket. */
             int clientDescriptor;
+
+            /* Scheduler on which coroutines wait for the socket. */
+            Scheduler &scheduler;
         };
 
-        /* Creates new client connection adn returns std::unique_ptr to it. */
-        [[nodiscard]] auto acceptConnection() const {
-            return std::make_unique<ClientConnection>(listenerDescriptor);
-        }
+        /* Accepts all awaiting client connections, but no more than acceptBatch of them,
+         * waiting for at least one. Returns std::unique_ptr to each of them. */
+        Task<std::vector<std::unique_ptr<ClientConnection>>> acceptConnections() const;
+
+        /* Returns amount of established connections awaiting in the listen queue. */
+        [[nodiscard]] size_t pendingConnections() const;
 
     private:
+        /* Sets options of the listening socket, including those inherited by accepted client sockets. */
+        void setListenerOptions() const;
+
         /* Maximum size of the queue of clients awaiting for connection. */
         static constexpr int MAX_LISTEN_QUEUE = 1024;
 
         /* Descriptor of the listening socket. */
         int listenerDescriptor;
+
+        /* Scheduler on which coroutines wait for connections. */
+        Scheduler &scheduler;
+
+        /* Tuning of the sockets. */
+        SocketOptions options;
     };
 }
 
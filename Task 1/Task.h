@@ -0,0 +1,235 @@
+#ifndef SIKZAD1_TASK_H
+#define SIKZAD1_TASK_H
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <optional>
+#include <utility>
+
+namespace SIK {
+    /* Pool of memory blocks for coroutine frames. Blocks are grouped in size classes
+     * and freed blocks are kept on per-class free lists, so that serving a client
+     * does not hit the general purpose allocator once the pool is warm. */
+    class FramePool {
+    public:
+        /* Returns block of memory of at least size bytes. */
+        static void *allocate(std::size_t size) {
+            if (size > MAX_POOLED_SIZE) {
+                return ::operator new(size);
+            }
+
+            FreeBlock *&freeList = freeLists[sizeClass(size)];
+
+            if (freeList != nullptr) {
+                FreeBlock *block = freeList;
+                freeList = block->next;
+                return block;
+            }
+
+            return ::operator new(sizeClass(size) * GRANULARITY);
+        }
+
+        /* Returns block of memory of given size, previously obtained from allocate(), to the pool. */
+        static void deallocate(void *ptr, std::size_t size) noexcept {
+            if (size > MAX_POOLED_SIZE) {
+                ::operator delete(ptr);
+                return;
+            }
+
+            FreeBlock *&freeList = freeLists[sizeClass(size)];
+
+            auto block = static_cast<FreeBlock *>(ptr);
+            block->next = freeList;
+            freeList = block;
+        }
+
+    private:
+        /* Sizes of blocks in the pool are multiples of this value. */
+        static constexpr std::size_t GRANULARITY = 64;
+
+        /* Frames larger than this value are allocated directly with operator new. */
+        static constexpr std::size_t MAX_POOLED_SIZE = 16384;
+
+        struct FreeBlock {
+            FreeBlock *next;
+        };
+
+        static constexpr std::size_t sizeClass(std::size_t size) {
+            return (size + GRANULARITY - 1) / GRANULARITY;
+        }
+
+        /* Free lists of blocks, indexed by size class. */
+        inline static thread_local FreeBlock *freeLists[MAX_POOLED_SIZE / GRANULARITY + 1]{};
+    };
+
+    /* Base of coroutine promises which allocates coroutine frames from FramePool. */
+    struct PooledFrame {
+        static void *operator new(std::size_t size) {
+            return FramePool::allocate(size);
+        }
+
+        static void operator delete(void *ptr, std::size_t size) noexcept {
+            FramePool::deallocate(ptr, size);
+        }
+    };
+
+    template<typename T>
+    class Task;
+
+    /* Part of the Task's promise independent of the type of the result. */
+    class TaskPromiseBase : public PooledFrame {
+    public:
+        /* Tasks are lazy - they start running when awaited. */
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        /* Awaiter resuming the coroutine that awaited the finished task. */
+        struct FinalAwaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+
+            template<typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                auto continuation = handle.promise().continuation;
+
+                return continuation ? continuation : std::noop_coroutine();
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        /* Finished task resumes the coroutine that awaited it. */
+        FinalAwaiter final_suspend() noexcept {
+            return {};
+        }
+
+        void unhandled_exception() noexcept {
+            exception = std::current_exception();
+        }
+
+    protected:
+        template<typename T>
+        friend class Task;
+
+        /* Coroutine awaiting the task. */
+        std::coroutine_handle<> continuation;
+
+        /* Exception thrown by the task, rethrown in the awaiting coroutine. */
+        std::exception_ptr exception;
+    };
+
+    template<typename T>
+    class TaskPromise : public TaskPromiseBase {
+    public:
+        Task<T> get_return_object() noexcept;
+
+        template<typename U>
+        void return_value(U &&value) {
+            result.emplace(std::forward<U>(value));
+        }
+
+        T takeResult() {
+            if (exception) {
+                std::rethrow_exception(exception);
+            }
+
+            return std::move(result.value());
+        }
+
+    private:
+        std::optional<T> result;
+    };
+
+    template<>
+    class TaskPromise<void> : public TaskPromiseBase {
+    public:
+        Task<void> get_return_object() noexcept;
+
+        void return_void() noexcept {}
+
+        void takeResult() {
+            if (exception) {
+                std::rethrow_exception(exception);
+            }
+        }
+    };
+
+    /* Lazily started coroutine returning value of type T to the coroutine that co_awaits it.
+     * Exceptions thrown inside the task are rethrown in the awaiting coroutine. */
+    template<typename T = void>
+    class [[nodiscard]] Task {
+    public:
+        using promise_type = TaskPromise<T>;
+
+        Task(Task &&other) noexcept: handle{std::exchange(other.handle, nullptr)} {}
+
+        Task &operator=(Task &&other) noexcept {
+            if (this != &other) {
+                destroy();
+                handle = std::exchange(other.handle, nullptr);
+            }
+
+            return *this;
+        }
+
+        Task(const Task &) = delete;
+
+        Task &operator=(const Task &) = delete;
+
+        ~Task() {
+            destroy();
+        }
+
+        /* Starts the task and suspends awaiting coroutine until the task finishes. */
+        auto operator co_await() && noexcept {
+            struct Awaiter {
+                std::coroutine_handle<promise_type> handle;
+
+                bool await_ready() noexcept {
+                    return !handle || handle.done();
+                }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                    handle.promise().continuation = awaiting;
+
+                    return handle;
+                }
+
+                T await_resume() {
+                    return handle.promise().takeResult();
+                }
+            };
+
+            return Awaiter{handle};
+        }
+
+    private:
+        friend class TaskPromise<T>;
+
+        explicit Task(std::coroutine_handle<promise_type> handle) noexcept: handle{handle} {}
+
+        void destroy() noexcept {
+            if (handle) {
+                handle.destroy();
+                handle = nullptr;
+            }
+        }
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    template<typename T>
+    Task<T> TaskPromise<T>::get_return_object() noexcept {
+        return Task<T>{std::coroutine_handle<TaskPromise<T>>::from_promise(*this)};
+    }
+
+    inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+        return Task<void>{std::coroutine_handle<TaskPromise<void>>::from_promise(*this)};
+    }
+}
+
+#endif //SIKZAD1_TASK_H
@@ -1,5 +1,9 @@
 #include <iostream>
 #include <csignal>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
 
 #include "HTTPServer.h"
 
@@ -11,6 +15,127 @@ namespace {
             return isdigit(ch);
         });
     }
+
+    /* Parses non-negative number not greater than maxValue. */
+    std::optional<unsigned long> parseNumber(const char *str, unsigned long maxValue) {
+        if (!isNonNegativeNumber(str)) {
+            return std::nullopt;
+        }
+
+        errno = 0;
+        auto number = strtoul(str, nullptr, 10);
+
+        if (errno == ERANGE || number > maxValue) {
+            return std::nullopt;
+        }
+
+        return number;
+    }
+
+    /* Parses option of form --name=value or --flag into options. Returns false if the option is invalid. */
+    bool parseOption(const std::string &option, SIK::ServerOptions &options) {
+        auto equalsPosition = option.find('=');
+
+        if (equalsPosition == std::string::npos) {
+            if (option == "--ipv6") {
+                options.socketOptions.dualStack = true;
+            } else if (option == "--tcp-nodelay") {
+                options.socketOptions.noDelay = true;
+            } else {
+                return false;
+            }
+
+            return true;
+        }
+
+        std::string name = option.substr(2, equalsPosition - 2);
+        std::string value = option.substr(equalsPosition + 1);
+
+        SIK::OverloadLimits &limits = options.overloadLimits;
+
+        if (name == "handoff-socket") {
+            options.handoffSocketPath = value;
+            return !value.empty();
+        }
+
+        if (name == "access-manifest") {
+            options.accessManifestPath = value;
+            return !value.empty();
+        }
+
+        if (name == "trace-file") {
+            options.traceOptions.chromeTracePath = value;
+            return !value.empty();
+        }
+
+        if (name == "warm-up") {
+            if (value == "blocking") {
+                options.warmUpMode = SIK::WarmUpMode::BLOCKING;
+            } else if (value == "background") {
+                options.warmUpMode = SIK::WarmUpMode::BACKGROUND;
+            } else {
+                return false;
+            }
+
+            return true;
+        }
+
+        if (name == "shed-mode") {
+            if (value == "503") {
+                limits.shedMode = SIK::ShedMode::SERVICE_UNAVAILABLE;
+            } else if (value == "close") {
+                limits.shedMode = SIK::ShedMode::CLOSE;
+            } else {
+                return false;
+            }
+
+            return true;
+        }
+
+        auto number = parseNumber(value.c_str(), std::numeric_limits<int32_t>::max());
+
+        if (!number) {
+            return false;
+        }
+
+        if (name == "max-connections") {
+            limits.maxConnections = number.value();
+        } else if (name == "max-in-flight") {
+            limits.maxInFlightRequests = number.value();
+        } else if (name == "max-accept-queue") {
+            limits.maxAcceptQueue = number.value();
+        } else if (name == "max-loop-lag-ms") {
+            limits.maxLoopLag = std::chrono::milliseconds{number.value()};
+        } else if (name == "retry-after") {
+            limits.retryAfterSeconds = number.value();
+        } else if (name == "drain-timeout") {
+            options.drainTimeout = std::chrono::seconds{number.value()};
+        } else if (name == "idle-timeout") {
+            options.idleTimeout = std::chrono::seconds{number.value()};
+        } else if (name == "file-cache") {
+            options.fileCacheCapacity = number.value();
+        } else if (name == "accept-batch") {
+            options.socketOptions.acceptBatch = number.value();
+        } else if (name == "defer-accept") {
+            options.socketOptions.deferAcceptSeconds = static_cast<int>(number.value());
+        } else if (name == "fast-open") {
+            options.socketOptions.fastOpenQueue = static_cast<int>(number.value());
+        } else if (name == "busy-poll") {
+            options.socketOptions.busyPollMicroseconds = static_cast<int>(number.value());
+        } else if (name == "send-buffer") {
+            options.socketOptions.sendBufferSize = static_cast<int>(number.value());
+        } else if (name == "receive-buffer") {
+            options.socketOptions.receiveBufferSize = static_cast<int>(number.value());
+        } else if (name == "trace-sample") {
+            options.traceOptions.sampleInterval = number.value();
+        } else if (name == "trace-slow-ms") {
+            options.traceOptions.slowRequestThreshold = std::chrono::milliseconds{number.value()};
+        } else {
+            return false;
+        }
+
+        return true;
+    }
 }
 
 int main(int argc, char *argv[]) {
@@ -19,33 +144,65 @@ int main(int argc, char *argv[]) {
 
     uint16_t port = SIK::DEFAULT_HTTP_PORT;
 
-    if (argc != 3 && argc != 4) {
+    SIK::ServerOptions options;
+    std::vector<char *> arguments;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            arguments.push_back(argv[i]);
+        } else if (!parseOption(argv[i], options)) {
+            std::cout << "Wrong option " << argv[i] << "!" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (arguments.size() != 2 && arguments.size() != 3) {
         std::cout << "Wrong argument count!\n"
-                  << "Run program by: ./serwer <files directory> <correlated servers> [<port number>]"
+                  << "Run program by: ./serwer <files directory or bundle> <correlated servers> [<port number>] [<options>]\n"
+                  << "Options:\n"
+                  << "  --ipv6                  listen on IPv6 socket accepting IPv4 clients as well\n"
+                  << "  --accept-batch=<n>      accept up to n clients per wakeup of the listening socket\n"
+                  << "  --defer-accept=<n>      accept clients once they send data, waiting up to n seconds\n"
+                  << "  --fast-open=<n>         enable TCP Fast Open with queue of n pending requests\n"
+                  << "  --tcp-nodelay           disable Nagle's algorithm on client sockets\n"
+                  << "  --busy-poll=<n>         busy poll for n microseconds when reading from clients\n"
+                  << "  --send-buffer=<n>       size of send buffers of client sockets in bytes\n"
+                  << "  --receive-buffer=<n>    size of receive buffers of client sockets in bytes\n"
+                  << "  --max-connections=<n>   reject new clients when n connections are open\n"
+                  << "  --max-in-flight=<n>     reject new clients when n requests are being performed\n"
+                  << "  --max-accept-queue=<n>  reject new clients when n connections await in listen queue\n"
+                  << "  --max-loop-lag-ms=<n>   reject new clients when event loop iteration takes over n ms\n"
+                  << "  --retry-after=<n>       Retry-After value sent to rejected clients\n"
+                  << "  --shed-mode=503|close   answer rejected clients with 503 or just close the connection\n"
+                  << "  --handoff-socket=<path> on restart take listening socket over from the process\n"
+                  << "                          serving <path>, then serve <path> for the next one\n"
+                  << "  --drain-timeout=<n>     seconds given to open connections to finish after restart\n"
+                  << "  --idle-timeout=<n>      close connections awaiting a request for n seconds, 0 disables\n"
+                  << "  --file-cache=<n>        keep up to n files from the files directory open\n"
+                  << "  --warm-up=blocking|background\n"
+                  << "                          fill file cache before listening or while serving\n"
+                  << "  --access-manifest=<path> remember hot files in <path> and prefetch them on start\n"
+                  << "  --trace-sample=<n>      trace phases of every n-th request\n"
+                  << "  --trace-slow-ms=<n>     print phases of traced requests taking at least n ms\n"
+                  << "  --trace-file=<path>     export traced requests to <path> in Chrome trace format"
                   << std::endl;
 
         return EXIT_FAILURE;
     }
 
-    if (argc == 4) {
-        if (isNonNegativeNumber(argv[3])) {
-            errno = 0;
-            auto number = strtol(argv[3], nullptr, 10);
-
-            if (errno == ERANGE || number < 0 || number > std::numeric_limits<uint16_t>::max()) {
-                std::cout << "Wrong port number" << std::endl;
-                return EXIT_FAILURE;
-            }
+    if (arguments.size() == 3) {
+        auto number = parseNumber(arguments[2], std::numeric_limits<uint16_t>::max());
 
-            port = static_cast<uint16_t>(number);
-        } else {
+        if (!number) {
             std::cout << "Wrong port number!" << std::endl;
             return EXIT_FAILURE;
         }
+
+        port = static_cast<uint16_t>(number.value());
     }
 
     try {
-        SIK::HTTPServer server{argv[1], argv[2], port};
+        SIK::HTTPServer server{arguments[0], arguments[1], port, options};
         server.start();
     } catch (const std::exception &e) {
         std::cout << e.what() << std::endl;
@@ -0,0 +1,24 @@
+#include <iostream>
+
+#include "ContentBundle.h"
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        std::cout << "Wrong argument count!\n"
+                  << "Run program by: ./pack <files directory> <bundle>\n"
+                  << "Packs files directory into bundle, which can be served by: ./serwer <bundle> ..."
+                  << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    try {
+        SIK::ContentBundle::pack(argv[1], argv[2]);
+    } catch (const std::exception &e) {
+        std::cout << e.what() << std::endl;
+        std::cout << "Packing failure!" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Bundle " << argv[2] << " has been written." << std::endl;
+}